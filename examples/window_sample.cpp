@@ -20,7 +20,11 @@ int main() {
     citrus::Vertex(citrus::Color(1.0f, 1.0f, 0.0f, 1.0f), citrus::Vector3f(-0.5f, -0.5f, 0.0f)),
     citrus::Vertex(citrus::Color(1.0f, 0.0f, 0.0f, 1.0f), citrus::Vector3f(-0.5f, 0.5f, 0.0f))
   });
+  // The square never changes, keep it on the GPU instead of uploading it every frame
+  auto square_mesh = renderer.createMesh(square_vertices);
   std::puts("Prepared vertices");
+  // Nothing moves, only draw when the window needs it instead of spinning
+  window.setEventMode(citrus::Window::EventMode::WAIT);
   while (window.isOpen()) {
     while (auto event = window.getEvent()) {
       if (event->matches<citrus::Window::Event::Closed>()) {
@@ -29,9 +33,7 @@ int main() {
       }
     }
     renderer.clearColor(citrus::Color::FromByteRGBA(40,160,240));
-    renderer.draw(square_vertices, generic_shader_program, [](citrus::opengl::ShaderProgram& program){
-      program.setUniformVal("in_color", citrus::Color::FromByteRGBA(255,0,0));
-    });
+    renderer.draw(square_mesh, generic_shader_program, citrus::opengl::DrawParams(citrus::Color::FromByteRGBA(255,0,0)));
     std::puts("Draw called");
     renderer.present();
     std::puts("Presented queue to gpu");
@@ -0,0 +1,94 @@
+#ifndef CITRUS_GRAPHICS_OPENGLCOMMANDBUFFER_HPP
+#define CITRUS_GRAPHICS_OPENGLCOMMANDBUFFER_HPP
+
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "Citrus/graphics/core/FrameArena.hpp"
+#include "Citrus/graphics/core/IndexBuffer.hpp"
+#include "Citrus/graphics/core/InstanceData.hpp"
+#include "Citrus/graphics/core/Vertex.hpp"
+#include "Citrus/graphics/core/VertexFormat.hpp"
+#include "DrawCommand.hpp"
+#include "Shader.hpp"
+
+namespace citrus::opengl {
+
+  // Records draws without touching GL, so it can be filled from any thread. Every thread records into its own
+  // buffer and the render thread hands them to Renderer::submit. The recorded data lives in the buffer's arena,
+  // the buffer must not be reset or destroyed until the frame it was submitted to has been presented.
+  // Moving a buffer keeps its recorded data in place, a moved-from buffer can only be assigned to or destroyed
+  class CommandBuffer {
+    public:
+    CommandBuffer() = default;
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+    CommandBuffer(CommandBuffer&&) noexcept = default;
+    CommandBuffer& operator=(CommandBuffer&&) noexcept = default;
+
+    void draw(VertexView buf, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+    void draw(VertexView buf, const IndexBuffer& indices, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+    void draw(VertexView buf, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {});
+    void draw(VertexView buf, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {});
+    void draw(DrawBatch&& batch, PreDrawFunc pre_draw_func, DrawOrder order = {});
+    // Draws vertices of any type with a VertexFormatOf specialization, like the compact types of CompactVertex.hpp.
+    // Batches only merge draws sharing a vertex format
+    template <typename TVertex>
+    void draw(std::span<TVertex> vertices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {}) {
+      this->drawVertices(VertexFormatOf<std::remove_const_t<TVertex>>::value, std::as_bytes(vertices), nullptr, shader_program, params, order);
+    }
+    template <typename TVertex>
+    void draw(std::span<TVertex> vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {}) {
+      this->drawVertices(VertexFormatOf<std::remove_const_t<TVertex>>::value, std::as_bytes(vertices), &indices, shader_program, params, order);
+    }
+    // Records a draw of count vertices and returns them to be written in place, saving the copy a VertexBuffer goes through.
+    // The memory is uninitialized, every vertex must be written before the frame the buffer is submitted to is presented
+    template <typename TVertex = Vertex>
+    std::span<TVertex> allocateVertices(size_t count, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {}) {
+      std::byte* memory = this->recordVertices(VertexFormatOf<TVertex>::value, count * sizeof(TVertex), alignof(TVertex), shader_program, params, order);
+      return std::span<TVertex>(std::launder(reinterpret_cast<TVertex*>(memory)), memory ? count : 0);
+    }
+    void drawInstanced(VertexView buf, std::span<const InstanceData> instances, ShaderProgram& shader_program, PreDrawFunc func = nullptr, DrawOrder order = {});
+    // Draws a mesh created by Renderer::createMesh, draws of destroyed meshes are skipped
+    void draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {});
+    void draw(MeshHandle mesh, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+
+    std::span<const DrawCommand> getCommands() const noexcept {
+      return recording_->commands;
+    }
+    size_t size() const noexcept {
+      return recording_->commands.size();
+    }
+    bool isEmpty() const noexcept {
+      return recording_->commands.empty();
+    }
+    // Heap allocations made since the last reset
+    size_t getAllocationCount() const noexcept {
+      return recording_->arena.getUpstreamAllocationCount();
+    }
+
+    void reset(); // Drops every recorded draw, keeping the memory for the next frame
+
+    private:
+    DrawCommand makeCommand(VertexView vertices, ShaderProgram& shader_program, DrawOrder order);
+    void copyIndices(DrawCommand& command, const IndexBuffer& indices);
+    void drawVertices(const VertexFormat& format, std::span<const std::byte> vertices, const IndexBuffer* indices,
+                      ShaderProgram& shader_program, const DrawParams& params, DrawOrder order);
+    std::byte* recordVertices(const VertexFormat& format, size_t size, size_t alignment, ShaderProgram& shader_program,
+                              const DrawParams& params, DrawOrder order);
+
+    // The commands allocate from the arena by address, so both live on the heap and move together
+    struct Recording {
+      FrameArena arena;
+      std::pmr::vector<DrawCommand> commands {&arena};
+    };
+    std::unique_ptr<Recording> recording_ = std::make_unique<Recording>();
+  };
+
+}
+
+#endif
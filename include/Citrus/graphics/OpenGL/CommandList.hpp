@@ -0,0 +1,109 @@
+#ifndef CITRUS_GRAPHICS_OPENGLCOMMANDLIST_HPP
+#define CITRUS_GRAPHICS_OPENGLCOMMANDLIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "Citrus/graphics/core/IndexBuffer.hpp"
+#include "Citrus/graphics/core/Vertex.hpp"
+#include "Citrus/graphics/core/VertexFormat.hpp"
+#include "CommandBuffer.hpp"
+#include "DrawCommand.hpp"
+#include "Mesh.hpp"
+#include "Shader.hpp"
+
+namespace citrus::opengl {
+
+  class Renderer;
+
+  // Draws recorded once and submitted every frame with Renderer::submit, for content that rarely changes like
+  // HUDs and backgrounds. close() validates and sorts the draws, then uploads every batch of compatible neighbours
+  // into a mesh of the renderer. Submitting queues one mesh draw per batch, nothing is sorted inside a batch or
+  // uploaded again, and draws can still be patched between frames. A list must outlive the frames it was submitted
+  // to, and be reset or destroyed before its renderer
+  class CommandList {
+    public:
+    using DrawId = uint32_t; // Order in which the draw was recorded
+
+    CommandList() = default;
+    CommandList(const CommandList&) = delete;
+    CommandList& operator=(const CommandList&) = delete;
+    ~CommandList();
+
+    DrawId draw(VertexView vertices, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {});
+    DrawId draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {});
+    // The pre-draw function runs every frame the list is submitted to, use it for uniform data
+    DrawId draw(VertexView vertices, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+    DrawId draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {});
+    template <typename TVertex>
+    DrawId draw(std::span<TVertex> vertices, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {}) {
+      this->checkRecording();
+      recorder_.draw(vertices, shader_program, params, order);
+      return static_cast<DrawId>(recorder_.size() - 1);
+    }
+
+    // Ends recording and creates the batches' meshes with the renderer's current frame.
+    // The list can only be submitted to that renderer
+    void close(Renderer& renderer);
+    bool isClosed() const noexcept {
+      return closed_;
+    }
+    // Drops every draw and the meshes, then starts recording again
+    void reset();
+
+    // Patches apply from the next submission, frames already submitted keep their own copy of the parameters.
+    // Vertex updates go to the batch's mesh with the renderer's current frame, like Renderer::updateMesh.
+    // Draws of the caller's own meshes have no vertices to update
+    void setParams(DrawId draw, const DrawParams& params);
+    template <typename TVertex>
+    void updateVertices(DrawId draw, size_t first_vertex, std::span<TVertex> vertices) {
+      this->writeVertices(draw, VertexFormatOf<std::remove_const_t<TVertex>>::value, first_vertex, std::as_bytes(vertices));
+    }
+
+    // One mesh draw per batch in submission order, only available once the list is closed
+    std::span<const DrawCommand> getCommands() const noexcept {
+      return commands_;
+    }
+    size_t size() const noexcept {
+      return closed_ ? draws_.size() : recorder_.size();
+    }
+    size_t getBatchCount() const noexcept {
+      return commands_.size();
+    }
+    // Renderer the list was closed for, null while recording
+    const Renderer* getRenderer() const noexcept {
+      return renderer_;
+    }
+
+    private:
+    static inline constexpr uint32_t NO_RANGE = UINT32_MAX;
+
+    // Where a recorded draw ended up once closed
+    struct DrawLocation {
+      uint32_t command = 0;       // Batch command drawing it
+      uint32_t range = NO_RANGE;  // Its piece of the batch's mesh, NO_RANGE for draws of the caller's meshes
+      uint32_t first_vertex = 0;  // In the batch's mesh
+      uint32_t vertex_count = 0;
+      const VertexFormat* vertex_format = nullptr;
+    };
+
+    void checkRecording() const;
+    const DrawLocation& getLocation(DrawId draw) const;
+    void writeVertices(DrawId draw, const VertexFormat& format, size_t first_vertex, std::span<const std::byte> vertices);
+    void releaseMeshes();
+
+    CommandBuffer recorder_; // Holds the recorded draws until they are uploaded by close()
+    std::vector<DrawCommand> commands_;
+    std::vector<MeshDrawRange> ranges_; // Reserved once when closing, the commands point into it
+    std::vector<DrawLocation> draws_;   // By DrawId
+    std::vector<MeshHandle> meshes_;
+    Renderer* renderer_ = nullptr;
+    bool closed_ = false;
+  };
+
+}
+
+#endif
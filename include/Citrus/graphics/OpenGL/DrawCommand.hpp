@@ -0,0 +1,113 @@
+#ifndef CITRUS_GRAPHICS_OPENGLDRAWCOMMAND_HPP
+#define CITRUS_GRAPHICS_OPENGLDRAWCOMMAND_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Citrus/graphics/core/IndexBuffer.hpp"
+#include "Citrus/graphics/core/InstanceData.hpp"
+#include "Citrus/graphics/core/Vertex.hpp"
+#include "Citrus/graphics/core/VertexFormat.hpp"
+#include "Mesh.hpp"
+#include "Shader.hpp"
+
+namespace citrus::opengl {
+
+  using PreDrawFunc =  void(*)(ShaderProgram& shader_program);
+  // Per draw parameters, they reach the shader through the instance attributes so draws
+  // with different parameters still end up in the same batch
+  using DrawParams = InstanceData;
+
+  // Vertices of a batch, viewed until the batch is drawn. Unlike a plain VertexView it can't be made from a
+  // temporary buffer, which would be gone before the batch is
+  class BatchVertexView : public VertexView {
+    public:
+    BatchVertexView(VertexView view) : VertexView(view) {}
+    BatchVertexView(const VertexBuffer& buffer) : VertexView(buffer.getView()) {}
+    BatchVertexView(VertexBuffer&&) = delete;
+  };
+
+  struct DrawBatch {
+    std::vector<BatchVertexView> vertex_buffers;
+    std::vector<IndexBuffer> index_buffers; // Either empty or one per vertex buffer
+    std::vector<DrawParams> draw_params; // Either empty or one per vertex buffer, not used by instanced batches
+    std::vector<InstanceData> instances; // Non empty for instanced batches, which hold a single vertex buffer
+    ShaderProgram* shader_program;
+    PreDrawFunc pre_draw_func;
+  };
+
+  // Ordering hints for a draw. Draws are sorted by layer first, inside a layer opaque draws go first grouped by
+  // shader and texture, translucent draws follow sorted back to front. Draws with equal keys keep their submission order
+  struct DrawOrder {
+    uint8_t layer = 0;
+    bool translucent = false;
+    float depth = 0.f;     // In [0, 1], smaller is closer to the viewer
+    uint16_t texture = 0;  // Texture the draw binds in its pre-draw function, 0 when none
+  };
+
+  // 64 bit sort key, from the most significant bit:
+  // opaque:      layer (8) | 0 | shader (16) | texture (15) | depth (24)
+  // translucent: layer (8) | 1 | inverted depth (24) | shader (16) | texture (15)
+  inline uint64_t MakeSortKey(const DrawOrder& order, unsigned int shader_program_id) {
+    constexpr uint64_t DEPTH_MAX = (1u << 24) - 1;
+    const uint64_t depth = static_cast<uint64_t>(std::clamp(order.depth, 0.f, 1.f) * DEPTH_MAX);
+    const uint64_t shader = shader_program_id & 0xFFFF;
+    const uint64_t texture = order.texture & 0x7FFF;
+    uint64_t key = static_cast<uint64_t>(order.layer) << 56;
+    if (order.translucent) {
+      key |= uint64_t(1) << 55;
+      key |= (DEPTH_MAX - depth) << 31;
+      key |= shader << 15;
+      key |= texture;
+    } else {
+      key |= shader << 39;
+      key |= texture << 24;
+      key |= depth;
+    }
+    return key;
+  }
+
+  // Piece of a retained mesh drawn with its own parameters. first and count are in indices for indexed meshes,
+  // in vertices otherwise
+  struct MeshDrawRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+    DrawParams params;
+  };
+
+  // A single submission waiting to be sorted into a batch, the data it points at lives in the renderer's frame arena.
+  // Commands of a closed CommandList point at the list's own ranges instead, submitting copies them to the frame
+  struct DrawCommand {
+    enum class Merge : uint8_t {
+      ANY,      // Merges with compatible neighbours
+      NONE,     // Starts a batch nothing else merges into, used by instanced draws and explicit batches
+      PREVIOUS  // Always part of the previous command's batch, used by the rest of an explicit batch
+    };
+    uint64_t sort_key = 0;
+    Merge merge = Merge::ANY;
+    ShaderProgram* shader_program = nullptr;
+    PreDrawFunc pre_draw_func = nullptr;
+    const VertexFormat* vertex_format = &VertexFormatOf<Vertex>::value;
+    std::span<const std::byte> vertices; // vertex_format->stride bytes per vertex
+    bool indexed = false;
+    IndexType index_type = IndexType::UINT16;
+    std::span<const std::byte> indices; // Values of index_type
+    std::span<const InstanceData> instances; // Non empty for instanced draws
+    MeshHandle mesh; // Valid for draws of a retained mesh, which have no vertices of their own
+    std::span<const MeshDrawRange> mesh_ranges; // Draws the mesh in pieces instead of whole, see CommandList
+    DrawParams params;
+
+    size_t getVertexCount() const noexcept {
+      return vertices.size() / vertex_format->stride;
+    }
+    size_t getIndexCount() const noexcept {
+      return indices.size() / (index_type == IndexType::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+    }
+  };
+
+}
+
+#endif
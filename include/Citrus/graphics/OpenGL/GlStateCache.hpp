@@ -0,0 +1,113 @@
+#ifndef CITRUS_GRAPHICS_OPENGLGLSTATECACHE_HPP
+#define CITRUS_GRAPHICS_OPENGLGLSTATECACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "Citrus/graphics/core/color.hpp"
+
+namespace citrus::opengl {
+
+  // Shadow copy of the GL state Citrus touches, calls setting state that is already current are skipped.
+  // There is one cache per context, made current on the thread the context is current on. Code calling GL
+  // behind the cache's back (e.g. in a pre-draw function) must call invalidate() afterwards
+  class GlStateCache {
+    public:
+    static inline constexpr size_t TEXTURE_UNITS = 16;
+
+    // Element array bindings are vertex array state and are not cached
+    enum class BufferTarget : uint8_t { ARRAY, COPY_WRITE, DRAW_INDIRECT, UNIFORM, COUNT };
+
+    struct Rect {
+      int x = 0, y = 0, width = 0, height = 0;
+      bool operator==(const Rect&) const = default;
+    };
+    struct Stats {
+      uint64_t issued = 0;
+      uint64_t elided = 0;
+    };
+
+    GlStateCache() { this->invalidate(); }
+    GlStateCache(const GlStateCache&) = delete;
+    GlStateCache& operator=(const GlStateCache&) = delete;
+
+    // Cache of the context current on the calling thread, nullptr when there is none
+    static GlStateCache* Current() noexcept {
+      return s_current_;
+    }
+    static void MakeCurrent(GlStateCache* cache) noexcept {
+      s_current_ = cache;
+    }
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vao);
+    void bindBuffer(BufferTarget target, unsigned int buffer);
+    void bindBufferBase(BufferTarget target, unsigned int index, unsigned int buffer); // Indexed uniform buffer bindings
+    void bindTexture2D(unsigned int unit, unsigned int texture);
+    void setBlend(bool enabled);
+    void setBlendFunc(unsigned int source_factor, unsigned int destination_factor);
+    void setDepthTest(bool enabled);
+    void setDepthFunc(unsigned int func);
+    void setScissorTest(bool enabled);
+    void setScissor(Rect rect);
+    void setViewport(Rect rect);
+    void setClearColor(Color color);
+
+    unsigned int getProgram() const noexcept {
+      return program_;
+    }
+    unsigned int getVertexArray() const noexcept {
+      return vertex_array_;
+    }
+    unsigned int getBuffer(BufferTarget target) const noexcept {
+      return buffers_[static_cast<size_t>(target)];
+    }
+
+    // GL resets bindings of deleted objects to 0, these keep the cache in sync
+    void onProgramDeleted(unsigned int program) noexcept;
+    void onVertexArrayDeleted(unsigned int vao) noexcept;
+    void onBufferDeleted(unsigned int buffer) noexcept;
+    void onTextureDeleted(unsigned int texture) noexcept;
+
+    // Forgets every cached value, the next call of each kind reaches GL
+    void invalidate() noexcept;
+
+    // Readable from any thread
+    Stats getStats() const noexcept {
+      return Stats{issued_.load(std::memory_order_relaxed), elided_.load(std::memory_order_relaxed)};
+    }
+    void resetStats() noexcept {
+      issued_.store(0, std::memory_order_relaxed);
+      elided_.store(0, std::memory_order_relaxed);
+    }
+
+    private:
+    static inline constexpr unsigned int UNKNOWN = ~0u;
+    static inline thread_local GlStateCache* s_current_ = nullptr;
+
+    // Only the owning thread counts, a plain load and store is enough and avoids a locked add per call
+    bool elide(bool current) noexcept {
+      auto& counter = current ? elided_ : issued_;
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return current;
+    }
+
+    unsigned int program_;
+    unsigned int vertex_array_;
+    std::array<unsigned int, static_cast<size_t>(BufferTarget::COUNT)> buffers_;
+    unsigned int active_texture_unit_;
+    std::array<unsigned int, TEXTURE_UNITS> textures_;
+    int blend_, depth_test_, scissor_test_; // -1 when unknown
+    unsigned int blend_source_, blend_destination_;
+    unsigned int depth_func_;
+    Rect scissor_, viewport_;
+    bool scissor_known_, viewport_known_, clear_color_known_;
+    Color clear_color_ {0.f, 0.f, 0.f, 0.f};
+    std::atomic<uint64_t> issued_ = 0;
+    std::atomic<uint64_t> elided_ = 0;
+  };
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CITRUS_GRAPHICS_OPENGLGPUPROFILER_HPP
+#define CITRUS_GRAPHICS_OPENGLGPUPROFILER_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace citrus::opengl {
+
+  // Measures GPU time with GL_TIMESTAMP queries, one when the frame starts and one after every draw call.
+  // Results are read FRAME_LATENCY frames later once they are available, so profiling never stalls the pipeline.
+  // Every method except getLatestReport must be called on the thread owning the context
+  class GpuProfiler {
+    public:
+    static inline constexpr size_t FRAME_LATENCY = 4;
+
+    // A single draw call: a batch, or a run of batches sharing a multi draw indirect call
+    struct DrawTiming {
+      unsigned int shader_program = 0;
+      size_t batch_count = 0;
+      size_t command_count = 0;
+      double milliseconds = 0.0;
+    };
+    struct ShaderTiming {
+      unsigned int shader_program = 0;
+      size_t draw_count = 0;
+      double milliseconds = 0.0;
+    };
+    struct FrameReport {
+      uint64_t frame = 0;
+      double milliseconds = 0.0; // From the start of the frame to its last draw
+      std::vector<DrawTiming> draws;
+      std::vector<ShaderTiming> shaders; // Draw times summed per shader program, slowest first
+    };
+
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+    ~GpuProfiler();
+
+    void beginFrame();
+    void endDraw(unsigned int shader_program, size_t batch_count, size_t command_count); // Call right after the draw
+    void endFrame();
+
+    // Latest frame whose results came back, frame is 0 until the first one does
+    FrameReport getLatestReport() const;
+    // Frames whose queries were still pending when their slot had to be reused
+    uint64_t getDroppedFrameCount() const noexcept {
+      return dropped_frames_;
+    }
+
+    private:
+    struct FrameQueries {
+      uint64_t frame = 0;
+      bool pending = false;
+      size_t query_count = 0; // Queries used this frame, the first one marks the start of the frame
+      std::vector<unsigned int> queries;
+      std::vector<DrawTiming> draws;
+    };
+
+    void timestamp(FrameQueries& frame);
+    bool collect(FrameQueries& frame);
+
+    std::array<FrameQueries, FRAME_LATENCY> frames_;
+    size_t current_ = 0;
+    uint64_t frame_count_ = 0;
+    uint64_t dropped_frames_ = 0;
+    std::vector<uint64_t> results_;
+    mutable std::mutex report_mutex_;
+    FrameReport report_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CITRUS_GRAPHICS_OPENGLMESH_HPP
+#define CITRUS_GRAPHICS_OPENGLMESH_HPP
+
+#include <cstdint>
+
+namespace citrus::opengl {
+
+  enum class MeshUsage : uint8_t {
+    STATIC,  // Uploaded once, GL_STATIC_DRAW
+    DYNAMIC  // Updated now and then through Renderer::updateMesh, GL_DYNAMIC_DRAW
+  };
+
+  // Geometry kept on the GPU by the renderer, drawing it uploads nothing. A default handle refers to no mesh
+  struct MeshHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // Tells a destroyed mesh from the one reusing its slot
+
+    bool isValid() const noexcept {
+      return generation != 0;
+    }
+    bool operator==(const MeshHandle&) const = default;
+  };
+
+}
+
+#endif
@@ -1,52 +1,349 @@
 #ifndef CITRUS_GRAPHICS_OPENGLRENDERER_HPP
 #define CITRUS_GRAPHICS_OPENGLRENDERER_HPP
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
-#include <queue>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include <filesystem>
 
 #include "Citrus/sys/sys.hpp"
+#include "Citrus/graphics/core/CompactVertex.hpp"
+#include "Citrus/graphics/core/FrameArena.hpp"
+#include "Citrus/graphics/core/IndexBuffer.hpp"
+#include "Citrus/graphics/core/InstanceData.hpp"
 #include "Citrus/graphics/core/Vertex.hpp"
+#include "Citrus/graphics/core/VertexFormat.hpp"
+#include "CommandBuffer.hpp"
+#include "CommandList.hpp"
+#include "DrawCommand.hpp"
+#include "GlStateCache.hpp"
+#include "GpuProfiler.hpp"
+#include "Mesh.hpp"
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
+#include "StreamBuffer.hpp"
+#include "UniformBlock.hpp"
 
 
 namespace citrus::opengl {
 
-  using PreDrawFunc =  void(*)(ShaderProgram& shader_program);
-
-  struct DrawBatch {
-    std::vector<VertexBuffer> vertex_buffers;
-    ShaderProgram* shader_program;
-    PreDrawFunc pre_draw_func;
-  };
-
   class Renderer {
     public:
     
     Renderer() = delete;
 
-    explicit Renderer(const Window& window);
+    // With a shader cache directory, the generic programs and those loaded through loadShaderProgram are cached there
+    explicit Renderer(const Window& window, std::optional<std::filesystem::path> shader_cache_directory = std::nullopt);
 
     ~Renderer();
 
     ShaderProgram& getGenericShaderProgram() {
       return generic_shader_program_;
     }
+    // Reads the InstanceData attributes, offsetting and scaling the mesh and multiplying its color per instance
+    ShaderProgram& getGenericInstancedShaderProgram() {
+      return generic_instanced_shader_program_;
+    }
 
     void useShaderProgram(ShaderProgram & program);
+    // Compiles and links the program, or loads it from the shader cache when the renderer has one
+    ShaderProgram loadShaderProgram(std::string_view vertex_source, std::string_view fragment_source);
+    ShaderCache* getShaderCache() noexcept {
+      return shader_cache_ ? &*shader_cache_ : nullptr;
+    }
 
-    void draw(const VertexBuffer& buf, ShaderProgram& shader_program,  PreDrawFunc func);
-    void draw(DrawBatch&& batch, PreDrawFunc pre_draw_func);
+    // Draws are queued with a sort key and merged into batches when presenting, see DrawOrder
+    void draw(VertexView buf, ShaderProgram& shader_program,  PreDrawFunc func, DrawOrder order = {});
+    void draw(VertexView buf, const IndexBuffer& indices, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+    // Draws with per draw parameters merge with any neighbour using the same program, whatever their parameters
+    void draw(VertexView buf, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {});
+    void draw(VertexView buf, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {});
+    void draw(DrawBatch&& batch, PreDrawFunc pre_draw_func, DrawOrder order = {});
+    // Draws vertices of any type with a VertexFormatOf specialization, see CompactVertex.hpp. The renderer
+    // configures a vertex array per format, draws of different formats never share a batch
+    template <typename TVertex>
+    void draw(std::span<TVertex> vertices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {}) {
+      CITRUS_PROFILE_SCOPE("Renderer::draw");
+      this->recordingPacket().command_buffer.draw(vertices, shader_program, params, order);
+    }
+    template <typename TVertex>
+    void draw(std::span<TVertex> vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order = {}) {
+      CITRUS_PROFILE_SCOPE("Renderer::draw");
+      this->recordingPacket().command_buffer.draw(vertices, indices, shader_program, params, order);
+    }
+    // Records a draw and returns its vertices to be written in place, for geometry generated every frame. The vertices
+    // live in the frame's memory and are copied to the GPU once when presenting, where a VertexBuffer is copied twice.
+    // The memory is uninitialized, every vertex must be written before the next present()
+    template <typename TVertex = Vertex>
+    std::span<TVertex> allocateVertices(size_t count, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {}) {
+      CITRUS_PROFILE_SCOPE("Renderer::allocateVertices");
+      return this->recordingPacket().command_buffer.template allocateVertices<TVertex>(count, shader_program, params, order);
+    }
+    // Draws the mesh once per instance, the mesh is uploaded a single time and instances go through their own attribute stream
+    void drawInstanced(VertexView buf, std::span<const InstanceData> instances, ShaderProgram& shader_program, PreDrawFunc func = nullptr, DrawOrder order = {});
+    // Keeps the geometry in its own GPU buffer so drawing it uploads nothing. Mesh operations are recorded with
+    // the frame like draws: creations and updates are applied before the frame's draws, destructions after them
+    MeshHandle createMesh(VertexView vertices, MeshUsage usage = MeshUsage::STATIC);
+    MeshHandle createMesh(VertexView vertices, const IndexBuffer& indices, MeshUsage usage = MeshUsage::STATIC);
+    template <typename TVertex>
+    MeshHandle createMesh(std::span<TVertex> vertices, MeshUsage usage = MeshUsage::STATIC) {
+      return this->recordMeshCreation(VertexFormatOf<std::remove_const_t<TVertex>>::value, std::as_bytes(vertices), nullptr, usage);
+    }
+    template <typename TVertex>
+    MeshHandle createMesh(std::span<TVertex> vertices, const IndexBuffer& indices, MeshUsage usage = MeshUsage::STATIC) {
+      return this->recordMeshCreation(VertexFormatOf<std::remove_const_t<TVertex>>::value, std::as_bytes(vertices), &indices, usage);
+    }
+    // Overwrites vertices starting at first_vertex, only that range is uploaded. The vertices must be of the type the mesh was created with
+    void updateMesh(MeshHandle mesh, size_t first_vertex, std::span<const Vertex> vertices);
+    template <typename TVertex>
+    void updateMesh(MeshHandle mesh, size_t first_vertex, std::span<TVertex> vertices) {
+      this->recordMeshUpdate(mesh, VertexFormatOf<std::remove_const_t<TVertex>>::value, first_vertex, std::as_bytes(vertices));
+    }
+    void destroyMesh(MeshHandle mesh);
+    void draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params = {}, DrawOrder order = {});
+    void draw(MeshHandle mesh, ShaderProgram& shader_program, PreDrawFunc func, DrawOrder order = {});
+    // Uploads the block's pending changes with the frame, before its draws, and works with a render thread unlike
+    // UniformBlock::upload. The changes are copied, the block itself must stay alive until the frame is presented
+    template <typename T>
+    void uploadUniformBlock(UniformBlock<T>& block) {
+      if (block.isDirty()) {
+        this->recordUniformUpload(block.getBuffer(), block.getDirtyOffset(), block.getDirtyBytes());
+        block.clearDirty();
+      }
+    }
+    // Binds the block from this frame's draws on, with the same lifetime rule
+    template <typename T>
+    void bindUniformBlock(UniformBlock<T>& block, unsigned int binding_point) {
+      this->recordUniformBind(block.getBuffer(), binding_point);
+    }
+    // Queues draws recorded on other threads, must be called from the thread owning the renderer.
+    // They are sorted together with every other draw of the frame, draws with equal keys keep the order
+    // of the calls to draw and submit, then the order of the buffers in the span
+    void submit(std::span<const CommandBuffer> command_buffers);
+    // Queues one mesh draw per batch of a list closed for this renderer, nothing is uploaded
+    void submit(const CommandList& command_list);
 
-    void clearColor(Color color);
+    void clearColor(Color color); // Clears the frame before its draws are submitted
     void present(); // Shows every change to the screen
 
+    // What present() does with a frame whose draws, clear color and window size hash the same as the previous
+    // frame's. Frames with pre-draw functions or mesh changes are always rendered. Outside RENDER, present() hashes
+    // every vertex, index and instance byte of the frame on the recording thread, about as costly as copying them
+    // once more, which only pays off for scenes that often stay still
+    enum class UnchangedFrames : uint8_t {
+      RENDER, // Renders every frame from scratch without hashing it, the default
+      REPLAY, // Redraws the previous frame's batches from the data already on the GPU, skipping sorting and uploads
+      // Neither draws nor swaps, the window keeps showing the previous frame and present() returns without waiting
+      // for vsync. Only for applications redrawing on demand, uniforms and textures changed without going through
+      // a pre-draw function are not noticed
+      SKIP
+    };
+    void setUnchangedFrames(UnchangedFrames mode) noexcept;
+    UnchangedFrames getUnchangedFrames() const noexcept {
+      return unchanged_frames_;
+    }
+    // Frames present() found unchanged so far
+    size_t getUnchangedFrameCount() const noexcept {
+      return unchanged_frame_count_;
+    }
+
+    // Moves GL submission and the buffer swap to a thread owned by the renderer, present() then hands the frame over
+    // and returns so the next frame can be recorded while the previous one is submitted. The render thread makes the
+    // window's context current, no GL calls may be made from other threads until stopRenderThread, create shader
+    // programs and uniform blocks before starting it and update blocks through uploadUniformBlock. Pre-draw functions
+    // run on the render thread, and command buffers passed to submit must stay alive until the following present() returns
+    void startRenderThread();
+    // Waits for the frame in flight and hands the context back to the calling thread
+    void stopRenderThread();
+    bool hasRenderThread() const noexcept {
+      return render_thread_.joinable();
+    }
+
+    // Times every draw call on the GPU, reports come back a few frames after the frame they describe
+    void setGpuProfiling(bool enabled) noexcept {
+      gpu_profiling_ = enabled;
+    }
+    bool isGpuProfiling() const noexcept {
+      return gpu_profiling_;
+    }
+    GpuProfiler::FrameReport getGpuFrameReport() const {
+      return gpu_profiler_.getLatestReport();
+    }
+    // Pre-draw functions changing GL state directly must invalidate it, GlStateCache::Current() returns it while they run
+    GlStateCache& getGlStateCache() noexcept {
+      return state_cache_;
+    }
+    GlStateCache::Stats getGlStateStats() const noexcept {
+      return state_cache_.getStats();
+    }
+
+    // Heap allocations the render queue made during the last presented frame, 0 once the frame arena has warmed up
+    size_t getFrameAllocationCount() const noexcept {
+      return frame_allocation_count_;
+    }
+
     private:
-    unsigned int vbo_ = 0, vao_ = 0, ebo_ = 0;
-    std::queue<DrawBatch> draw_batch_queue_;
-    size_t allocated_vertex_count_ = 0;
+    friend class CommandList; // Creates and updates the meshes of its batches
+    static inline constexpr size_t VERTEX_STREAM_REGION_SIZE = 1024 * sizeof(Vertex);
+    static inline constexpr size_t INDEX_STREAM_REGION_SIZE = 1536 * sizeof(uint16_t);
+    static inline constexpr size_t INSTANCE_STREAM_REGION_SIZE = 256 * sizeof(InstanceData);
+    static inline constexpr size_t INDIRECT_STREAM_REGION_SIZE = 4096;
+
+    // A run of sorted commands drawn together, and where it landed in the frame's upload
+    struct BatchRange {
+      size_t first_command = 0; // Index into sorted_command_queue_
+      size_t command_count = 0;
+      bool mergeable = true;
+      bool instanced = false;
+      bool indexed = false;
+      const VertexFormat* vertex_format = nullptr;
+      size_t first_vertex = 0; // In vertices of vertex_format from the start of the vertex stream
+      size_t vertex_count = 0;
+      size_t index_offset = 0; // In bytes from the start of the index stream
+      size_t index_count = 0;
+      IndexType index_type = IndexType::UINT16;
+      size_t instance_offset = 0; // In bytes from the start of the instance stream, holds the instances or the draw parameters
+      size_t instance_count = 0;
+      bool uniform_params = true; // Every draw of the batch uses the same parameters
+    };
+    // Consecutive compatible batches, submitted with a single multi draw indirect call when there is more than one
+    struct DrawRun {
+      size_t first_batch = 0;
+      size_t batch_count = 0;
+      size_t command_count = 0; // Indirect commands, 0 when the run is issued batch by batch
+      size_t indirect_offset = 0; // In bytes from the start of the indirect stream
+    };
+
+    // Vertex arrays reading one vertex format from the streams, created the first time the format is drawn
+    struct StreamVertexArrays {
+      const VertexFormat* format = nullptr;
+      unsigned int vao = 0, instanced_vao = 0;
+      uint64_t vertex_generation = 0, index_generation = 0; // Storage of the streams the vaos currently point at
+    };
+
+    const StreamVertexArrays& getStreamVertexArrays(const VertexFormat* format);
+    void bindStreams(StreamVertexArrays& arrays);
+    void bindInstanceStream(size_t offset);
+    void setDrawParams(const DrawParams& params);
+    struct MeshOp {
+      enum class Type : uint8_t { CREATE, UPDATE, DESTROY };
+      Type type = Type::CREATE;
+      MeshHandle mesh;
+      MeshUsage usage = MeshUsage::STATIC;
+      size_t first_vertex = 0;
+      const VertexFormat* vertex_format = nullptr;
+      std::span<const std::byte> vertices;
+      IndexType index_type = IndexType::UINT16;
+      std::span<const std::byte> indices;
+    };
+    // Uniform buffer changes, applied in order before the frame's draws
+    struct UniformOp {
+      enum class Type : uint8_t { UPLOAD, BIND };
+      Type type = Type::UPLOAD;
+      UniformBuffer* buffer = nullptr;
+      size_t offset = 0;
+      std::span<const std::byte> bytes;
+      unsigned int binding_point = 0;
+    };
+    // Recording side of a mesh, handles are given out and checked without touching GL
+    struct MeshSlot {
+      uint32_t generation = 0;
+      bool alive = false;
+      const VertexFormat* vertex_format = nullptr;
+      size_t vertex_count = 0;
+    };
+    // Submission side of a mesh
+    struct GpuMesh {
+      uint32_t generation = 0;
+      unsigned int vao = 0, vertex_buffer = 0, index_buffer = 0;
+      size_t vertex_count = 0;
+      size_t index_count = 0;
+      IndexType index_type = IndexType::UINT16;
+    };
+
+    // Everything recorded for a frame, double buffered so one frame can be recorded while the other is submitted
+    struct FramePacket {
+      FrameArena arena;
+      CommandBuffer command_buffer; // Records the draws made through the renderer itself
+      size_t immediate_commands_queued = 0;
+      std::pmr::vector<DrawCommand> draw_command_queue {&arena};
+      std::optional<Color> clear_color;
+      std::pmr::vector<MeshOp> mesh_ops {&arena};
+      std::pmr::vector<UniformOp> uniform_ops {&arena};
+      bool unchanged = false; // Same as the previous frame, replayed without rebuilding the batches
+    };
+
+    FramePacket& recordingPacket() {
+      return frame_packets_[recording_packet_];
+    }
+    void queueImmediateCommands(FramePacket& packet);
+    void renderFrame(FramePacket& packet);
+    void resetFramePacket(FramePacket& packet);
+    void renderThreadMain();
+    std::optional<uint64_t> hashFrame(const FramePacket& packet) const;
+    MeshHandle allocateMesh(const VertexFormat& format, size_t vertex_count);
+    MeshHandle recordMeshCreation(const VertexFormat& format, std::span<const std::byte> vertices, const IndexBuffer* indices, MeshUsage usage);
+    void recordMeshUpdate(MeshHandle mesh, const VertexFormat& format, size_t first_vertex, std::span<const std::byte> vertices);
+    MeshSlot& getMeshSlot(MeshHandle mesh);
+    void applyMeshOps(const FramePacket& packet, bool destructions);
+    void recordUniformUpload(UniformBuffer& buffer, size_t offset, std::span<const std::byte> bytes);
+    void recordUniformBind(UniformBuffer& buffer, unsigned int binding_point);
+    void applyUniformOps(const FramePacket& packet);
+    const GpuMesh* findGpuMesh(MeshHandle mesh) const;
+    void drawMesh(const DrawCommand& command);
+    std::span<const DrawCommand> batchCommands(const BatchRange& batch) const;
+    void buildBatches(std::span<const DrawCommand> commands);
+    void uploadBatches();
+    void encodeDrawRuns();
+    bool canShareIndirectDraw(size_t first_batch, size_t batch_index) const;
+    void drawBatch(size_t batch_index);
+
+    GlStateCache state_cache_; // Every GL state change of the renderer goes through it
+    std::vector<StreamVertexArrays> stream_vertex_arrays_;
+    StreamBuffer vertex_stream_;
+    StreamBuffer index_stream_; // Backs the vao's element buffer
+    StreamBuffer instance_stream_;
+    StreamBuffer indirect_stream_; // Only created when the context supports multi draw indirect
+    bool multi_draw_indirect_ = false;
+    // Queued commands live in the packet's arena, it is reset once the frame is presented. The data they point at
+    // lives in the command buffer they were recorded into. The sorting and batching vectors below are only used
+    // while submitting and keep their capacity between frames instead
+    std::array<FramePacket, 2> frame_packets_;
+    size_t recording_packet_ = 0;
+    std::atomic<size_t> frame_allocation_count_ = 0;
+    UnchangedFrames unchanged_frames_ = UnchangedFrames::RENDER;
+    std::optional<uint64_t> last_frame_hash_; // Empty when the previous frame can't be replayed
+    size_t unchanged_frame_count_ = 0;
+    std::vector<DrawCommand> sorted_command_queue_;
+    std::vector<std::pair<uint64_t, uint32_t>> sorted_commands_, sort_scratch_; // Sort key and command index
+    std::vector<BatchRange> batch_ranges_;
+    std::vector<DrawRun> draw_runs_;
+    std::vector<MeshSlot> mesh_slots_;
+    std::vector<uint32_t> free_mesh_slots_;
+    std::vector<uint32_t> released_mesh_slots_; // Reusable once the frame destroying them has been presented
+    std::vector<GpuMesh> gpu_meshes_;
     const Window* window_ = nullptr;
+    std::optional<ShaderCache> shader_cache_;
     ShaderProgram generic_shader_program_; // Generic shader program shall be used for simple 2d draw operations;
+    ShaderProgram generic_instanced_shader_program_;
+    GpuProfiler gpu_profiler_; // Only used while submitting
+    std::atomic<bool> gpu_profiling_ = false;
+
+    std::thread render_thread_;
+    std::mutex frame_mutex_;
+    std::condition_variable frame_cv_;
+    FramePacket* pending_packet_ = nullptr; // Handed to the render thread, cleared once it has been presented
+    bool stop_render_thread_ = false;
+    std::exception_ptr render_error_;
   };
   
 }
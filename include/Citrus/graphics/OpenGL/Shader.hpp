@@ -1,10 +1,19 @@
+#ifndef CITRUS_GRAPHICS_OPENGLSHADER_HPP
+#define CITRUS_GRAPHICS_OPENGLSHADER_HPP
+
 #include <filesystem>
 #include <fstream>
+#include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "Citrus/graphics/core/color.hpp"
 #include "Citrus/sys/Vector2.hpp"
 #include "Citrus/sys/Vector3.hpp"
+#include "GlStateCache.hpp"
+#include "UniformId.hpp"
 
 namespace citrus::opengl {
   class ShaderProgram;
@@ -33,43 +42,87 @@ namespace citrus::opengl {
 
   class ShaderProgram {
    public:
-    static void setActiveProgramId(unsigned int id) {
-      s_active_shader_program_handle_ = id;
-    }
+    // Program in use on the calling thread's context, as tracked by its GlStateCache
     static unsigned int getActiveProgramId() {
-      return s_active_shader_program_handle_;
+      GlStateCache* cache = GlStateCache::Current();
+      return cache ? cache->getProgram() : 0;
     }
 
     ShaderProgram() = default;
-    ShaderProgram(const Shader& vertexShader, const Shader& fragmentShader);
+    // binary_retrievable asks the driver to keep the binary available for getBinary
+    ShaderProgram(const Shader& vertexShader, const Shader& fragmentShader, bool binary_retrievable = false);
+    // Loads a binary returned by getBinary, fails when the driver rejects it (e.g. after a driver update)
+    static std::optional<ShaderProgram> FromBinary(unsigned int format, std::span<const std::byte> binary);
+    // Takes ownership of a program that was linked successfully, e.g. by ShaderCompiler
+    static ShaderProgram FromLinkedProgram(unsigned int program_handle);
     ShaderProgram& operator=(const ShaderProgram&) = delete;
     ShaderProgram(ShaderProgram&& other) noexcept {
       this->shader_program_handle_ = other.shader_program_handle_;
+      this->uniforms_ = std::move(other.uniforms_);
       other.shader_program_handle_ = 0;
     }
     ShaderProgram& operator=(ShaderProgram&& other) noexcept {
       this->shader_program_handle_ = other.shader_program_handle_;
+      this->uniforms_ = std::move(other.uniforms_);
       other.shader_program_handle_ = 0;
       return *this;
     }
     bool operator==(const ShaderProgram& other) {
-      return shader_program_handle_ == other.s_active_shader_program_handle_;
+      return shader_program_handle_ == other.shader_program_handle_;
     }
     ~ShaderProgram();
 
     inline bool isActive() {
-      return s_active_shader_program_handle_ == this->shader_program_handle_;
+      return getActiveProgramId() == this->shader_program_handle_;
     }
 
     inline unsigned int getId() {
       return shader_program_handle_;
     }
 
-    void setUniformVal(std::string_view uniform_name, Vector2f value);
-    void setUniformVal(std::string_view uniform_name, Vector3f value);
-    void setUniformVal(std::string_view uniform_name, Color value);
-    void setUniformVal(std::string_view uniform_name, float value);
-    void setUniformVal(std::string_view uniform_name, int value);
+    // Active uniform reflected when the program was linked
+    struct Uniform {
+      UniformId id;
+      int location = -1;
+      unsigned int type = 0; // GL type enum
+      int size = 0; // Array length, 1 for plain uniforms
+      std::string name;
+    };
+
+    const std::vector<Uniform>& getUniforms() const noexcept {
+      return uniforms_;
+    }
+    // Looks the uniform up in the reflected table, -1 when the program has no such active uniform
+    int getUniformLocation(UniformId id) const noexcept;
+    int getUniformLocation(std::string_view uniform_name) const noexcept {
+      return getUniformLocation(UniformId(uniform_name));
+    }
+
+    // Setting by location is a plain GL call, by id a lookup in the reflected table, by name a hash and a lookup
+    void setUniformVal(int location, Vector2f value);
+    void setUniformVal(int location, Vector3f value);
+    void setUniformVal(int location, Color value);
+    void setUniformVal(int location, float value);
+    void setUniformVal(int location, int value);
+    // Uniforms are single precision, without this a double literal would be ambiguous between float and int
+    void setUniformVal(int location, double value) {
+      setUniformVal(location, static_cast<float>(value));
+    }
+    template <typename T>
+    void setUniformVal(UniformId id, T value) {
+      setUniformVal(getUniformLocation(id), value);
+    }
+    template <typename T>
+    void setUniformVal(std::string_view uniform_name, T value) {
+      setUniformVal(getUniformLocation(uniform_name), value);
+    }
+
+
+    // Driver specific program binary, empty when the context can't retrieve program binaries (before GL 4.1)
+    std::vector<std::byte> getBinary(unsigned int& format) const;
+
+    // Reads the uniform block named block_name from the buffer bound to binding_point, see UniformBlock
+    void bindUniformBlock(std::string_view block_name, unsigned int binding_point);
 
     void getUniformVal(std::string_view uniform_name, Vector2f& value);
     void getUniformVal(std::string_view uniform_name, Vector3f& value);
@@ -78,8 +131,10 @@ namespace citrus::opengl {
     void getUniformVal(std::string_view uniform_name, int& value);
 
    private:
-    static inline unsigned int s_active_shader_program_handle_ = 0;
+    void reflectUniforms();
+
     unsigned int shader_program_handle_ = 0;
+    std::vector<Uniform> uniforms_; // Sorted by id
   };
 
   inline constexpr unsigned int CitrusGlToGlShaderType(citrus::opengl::Shader::ShaderType type) {
@@ -94,4 +149,6 @@ namespace citrus::opengl {
     return 0; 
   }
 
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CITRUS_GRAPHICS_OPENGLSHADERCACHE_HPP
+#define CITRUS_GRAPHICS_OPENGLSHADERCACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Shader.hpp"
+
+namespace citrus::opengl {
+
+  // Keeps linked program binaries on disk so later runs skip compiling and linking.
+  // Entries are keyed by a hash of the sources, the defines and the GL vendor, renderer and version strings, a
+  // binary the driver rejects is replaced by compiling from source. Needs GL 4.1, older contexts always compile
+  class ShaderCache {
+    public:
+    explicit ShaderCache(std::filesystem::path directory);
+
+    // Defines are inserted after the #version line of both sources, e.g. "USE_FOG" or "LIGHT_COUNT 4"
+    ShaderProgram load(std::string_view vertex_source, std::string_view fragment_source, std::span<const std::string_view> defines = {});
+
+    uint64_t getHitCount() const noexcept {
+      return hits_;
+    }
+    uint64_t getMissCount() const noexcept {
+      return misses_;
+    }
+
+    private:
+    std::filesystem::path directory_;
+    std::string driver_; // Vendor, renderer and version, a driver update invalidates every entry
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+  };
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CITRUS_GRAPHICS_OPENGLSHADERCOMPILER_HPP
+#define CITRUS_GRAPHICS_OPENGLSHADERCOMPILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Shader.hpp"
+
+namespace citrus::opengl {
+
+  // Compiles and links programs without waiting for each one. submit() hands every shader to the driver right
+  // away, poll() (once per frame) picks up the finished ones. With GL_KHR_parallel_shader_compile the driver
+  // compiles on its own threads and poll() only asks which programs are done, otherwise poll() finishes programs
+  // one by one until its time budget runs out. Must be used on the thread owning the context
+  class ShaderCompiler {
+    public:
+    enum class Status : uint8_t { PENDING, READY, FAILED };
+
+    struct Handle {
+      uint32_t index = 0;
+    };
+
+    ShaderCompiler();
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+    ~ShaderCompiler();
+
+    Handle submit(std::string_view vertex_source, std::string_view fragment_source);
+    // Returns the number of programs still pending
+    size_t poll(std::chrono::microseconds budget = std::chrono::microseconds(2000));
+
+    Status getStatus(Handle handle) const;
+    // Compile and link logs of a failed program
+    const std::string& getError(Handle handle) const;
+    // Moves the program out of the compiler, throws the logs when it failed
+    ShaderProgram take(Handle handle);
+
+    bool hasParallelCompile() const noexcept {
+      return parallel_compile_;
+    }
+
+    private:
+    struct Job {
+      Status status = Status::PENDING;
+      unsigned int program = 0;
+      unsigned int vertex_shader = 0, fragment_shader = 0;
+      std::string error;
+      bool taken = false;
+    };
+
+    Job& getJob(Handle handle);
+    const Job& getJob(Handle handle) const;
+    void finish(Job& job);
+
+    bool parallel_compile_ = false;
+    std::vector<Job> jobs_;
+    std::vector<uint32_t> pending_; // Indices of pending jobs in submission order
+  };
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef CITRUS_GRAPHICS_OPENGLSTD140_HPP
+#define CITRUS_GRAPHICS_OPENGLSTD140_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace citrus::opengl {
+
+  enum class Std140Type : uint8_t { FLOAT, INT, UINT, VEC2, VEC3, VEC4, MAT4 };
+
+  struct Std140Member {
+    size_t offset; // offsetof in the C++ struct
+    size_t size;   // sizeof the C++ member
+    Std140Type type;
+    size_t count = 1; // Array length
+  };
+
+  // Describes the members of a struct mirroring a std140 uniform block, in declaration order:
+  //   template <> struct Std140Layout<Camera> {
+  //     static constexpr Std140Member members[] = {CITRUS_STD140_MEMBER(Camera, view, MAT4), ...};
+  //   };
+  template <typename T>
+  struct Std140Layout;
+
+  constexpr size_t Std140BaseAlignment(Std140Type type) {
+    switch (type) {
+      case Std140Type::FLOAT:
+      case Std140Type::INT:
+      case Std140Type::UINT:
+        return 4;
+      case Std140Type::VEC2:
+        return 8;
+      case Std140Type::VEC3:
+      case Std140Type::VEC4:
+      case Std140Type::MAT4:
+        return 16;
+    }
+    return 16;
+  }
+
+  constexpr size_t Std140Size(Std140Type type) {
+    switch (type) {
+      case Std140Type::FLOAT:
+      case Std140Type::INT:
+      case Std140Type::UINT:
+        return 4;
+      case Std140Type::VEC2:
+        return 8;
+      case Std140Type::VEC3:
+        return 12;
+      case Std140Type::VEC4:
+        return 16;
+      case Std140Type::MAT4:
+        return 64;
+    }
+    return 0;
+  }
+
+  // Index of the first member placed where std140 wouldn't put it, -1 when the whole layout matches.
+  // Array elements are aligned to and strided by 16 bytes, so the C++ side has to pad them
+  template <typename T>
+  constexpr int Std140FirstMismatch() {
+    size_t end = 0;
+    int index = 0;
+    for (const Std140Member& member : Std140Layout<T>::members) {
+      const size_t alignment = member.count > 1 ? 16 : Std140BaseAlignment(member.type);
+      const size_t stride = (Std140Size(member.type) + 15) / 16 * 16;
+      const size_t size = member.count > 1 ? stride * member.count : Std140Size(member.type);
+      if (member.offset % alignment != 0 || member.offset < end || member.size != size) {
+        return index;
+      }
+      end = member.offset + size;
+      index++;
+    }
+    return sizeof(T) % 16 == 0 ? -1 : index;
+  }
+
+}
+
+#define CITRUS_STD140_MEMBER(Struct, member, type) \
+  ::citrus::opengl::Std140Member{offsetof(Struct, member), sizeof(Struct::member), ::citrus::opengl::Std140Type::type, 1}
+#define CITRUS_STD140_ARRAY(Struct, member, type, count) \
+  ::citrus::opengl::Std140Member{offsetof(Struct, member), sizeof(Struct::member), ::citrus::opengl::Std140Type::type, count}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CITRUS_GRAPHICS_OPENGLSTREAMBUFFER_HPP
+#define CITRUS_GRAPHICS_OPENGLSTREAMBUFFER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace citrus::opengl {
+
+  // Ring buffer used to stream per-frame data to the GPU.
+  // When the context exposes buffer storage (GL 4.4+) the buffer is persistently mapped and split into
+  // FRAMES_IN_FLIGHT regions, each guarded by a fence, so writes go straight into GPU visible memory.
+  // Older contexts (the 3.3 core fallback) write into a CPU staging copy and orphan the buffer every frame.
+  class StreamBuffer {
+    public:
+    static inline constexpr size_t FRAMES_IN_FLIGHT = 3;
+
+    struct Allocation {
+      std::byte* data = nullptr;
+      size_t offset = 0; // Offset in bytes from the start of the GL buffer
+    };
+
+    StreamBuffer() = default;
+    explicit StreamBuffer(size_t region_size);
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    StreamBuffer(StreamBuffer&& other) noexcept;
+    StreamBuffer& operator=(StreamBuffer&& other) noexcept;
+    ~StreamBuffer();
+
+    // Returns writable memory for the current frame, the offset is rounded up to a multiple of alignment.
+    // Memory returned by previous allocations stays valid until the next flush(). A persistent buffer recreates its
+    // storage to grow, which would move earlier allocations of the frame, so it throws if it has to grow past the
+    // first allocation of a frame. Allocate a stream once per frame with the whole frame's size
+    Allocation allocate(size_t size, size_t alignment);
+    // Makes everything allocated since the last flush visible to the GPU
+    void flush();
+    // Fences the current region, the next allocation will start a new frame
+    void endFrame();
+    // Fences the region of the last frame again, for when its data is drawn a second time without allocating anything
+    void fenceLastFrameAgain();
+
+    unsigned int getId() const noexcept {
+      return buffer_handle_;
+    }
+    // Changes whenever the GL buffer is recreated. GL may hand out the name of the deleted buffer again,
+    // so vertex arrays pointing at the stream compare this instead of the id
+    uint64_t getGeneration() const noexcept {
+      return generation_;
+    }
+    bool isPersistent() const noexcept {
+      return persistent_;
+    }
+
+    private:
+    void beginFrame();
+    void createStorage(size_t region_size);
+    void destroyStorage();
+
+    unsigned int buffer_handle_ = 0;
+    uint64_t generation_ = 0;
+    bool persistent_ = false;
+    bool frame_started_ = false;
+    std::byte* mapped_ = nullptr;
+    size_t region_size_ = 0;
+    size_t region_index_ = 0;
+    size_t head_ = 0;      // Absolute offset of the next free byte
+    size_t flushed_ = 0;   // Absolute offset up to which data has been made visible
+    std::array<void*, FRAMES_IN_FLIGHT> fences_ {};
+    std::vector<std::byte> staging_; // Only used when the buffer can't be persistently mapped
+  };
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef CITRUS_GRAPHICS_OPENGLUNIFORMBLOCK_HPP
+#define CITRUS_GRAPHICS_OPENGLUNIFORMBLOCK_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+#include "Shader.hpp"
+#include "Std140.hpp"
+
+namespace citrus::opengl {
+
+  // Uniform buffer object holding a single block, the typed interface is UniformBlock<T>
+  class UniformBuffer {
+    public:
+    UniformBuffer() = default;
+    explicit UniformBuffer(size_t size, const void* data);
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    UniformBuffer(UniformBuffer&& other) noexcept;
+    UniformBuffer& operator=(UniformBuffer&& other) noexcept;
+    ~UniformBuffer();
+
+    // Both throw when the calling thread has no GL context, like the application thread while a render thread runs
+    void upload(size_t offset, size_t size, const void* data);
+    // Makes the buffer the block bound to binding_point, programs pick it up through ShaderProgram::bindUniformBlock
+    void bind(unsigned int binding_point) const;
+    unsigned int getId() const noexcept {
+      return buffer_handle_;
+    }
+
+    private:
+    void release();
+
+    unsigned int buffer_handle_ = 0;
+  };
+
+  // C++ struct backed by a uniform buffer, its layout is checked against std140 at compile time through
+  // Std140Layout<T>. Changes are tracked as one dirty range and uploaded together by upload(), so a block shared
+  // by several programs (camera, material...) costs one upload per frame however many programs read it.
+  // upload() and bind() call GL right away, with a render thread use Renderer::uploadUniformBlock and
+  // Renderer::bindUniformBlock instead. Blocks create their buffer on construction, before starting the render thread
+  template <typename T>
+  class UniformBlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Uniform blocks are uploaded as raw bytes");
+    static_assert(Std140FirstMismatch<T>() == -1, "T doesn't follow the std140 layout, Std140FirstMismatch<T>() is the first wrong member");
+
+    public:
+    UniformBlock() : UniformBlock(T{}) {}
+    explicit UniformBlock(const T& data) : data_(data), buffer_(sizeof(T), &data_) {}
+
+    const T& get() const noexcept {
+      return data_;
+    }
+    // Write access to the whole block, all of it is uploaded next time
+    T& edit() noexcept {
+      this->markDirty(0, sizeof(T));
+      return data_;
+    }
+    template <typename TMember>
+    void set(TMember T::*member, const TMember& value) {
+      data_.*member = value;
+      const size_t offset = reinterpret_cast<const std::byte*>(&(data_.*member)) - reinterpret_cast<const std::byte*>(&data_);
+      this->markDirty(offset, sizeof(TMember));
+    }
+    void markDirty(size_t offset, size_t size) noexcept {
+      dirty_begin_ = std::min(dirty_begin_, offset);
+      dirty_end_ = std::max(dirty_end_, offset + size);
+    }
+    bool isDirty() const noexcept {
+      return dirty_begin_ < dirty_end_;
+    }
+
+    // Bytes changed since the last upload, they start getDirtyOffset() bytes into the block
+    size_t getDirtyOffset() const noexcept {
+      return dirty_begin_;
+    }
+    std::span<const std::byte> getDirtyBytes() const noexcept {
+      if (!this->isDirty()) {
+        return {};
+      }
+      return std::span<const std::byte>(reinterpret_cast<const std::byte*>(&data_) + dirty_begin_, dirty_end_ - dirty_begin_);
+    }
+    void clearDirty() noexcept {
+      dirty_begin_ = sizeof(T);
+      dirty_end_ = 0;
+    }
+
+    // Uploads the bytes changed since the last upload, if any
+    void upload() {
+      if (this->isDirty()) {
+        const auto bytes = this->getDirtyBytes();
+        buffer_.upload(dirty_begin_, bytes.size(), bytes.data());
+        this->clearDirty();
+      }
+    }
+    void bind(unsigned int binding_point) const {
+      buffer_.bind(binding_point);
+    }
+    UniformBuffer& getBuffer() noexcept {
+      return buffer_;
+    }
+    const UniformBuffer& getBuffer() const noexcept {
+      return buffer_;
+    }
+
+    private:
+    T data_;
+    UniformBuffer buffer_;
+    size_t dirty_begin_ = sizeof(T);
+    size_t dirty_end_ = 0;
+  };
+
+}
+
+#endif
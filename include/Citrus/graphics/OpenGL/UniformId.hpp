@@ -0,0 +1,38 @@
+#ifndef CITRUS_GRAPHICS_OPENGLUNIFORMID_HPP
+#define CITRUS_GRAPHICS_OPENGLUNIFORMID_HPP
+
+#include <cstdint>
+#include <string_view>
+
+namespace citrus::opengl {
+
+  // 32 bit FNV-1a hash of a uniform name, computed at compile time by the _uid literal.
+  // Array uniforms are named without their [0] suffix
+  struct UniformId {
+    uint32_t value = 0;
+
+    constexpr UniformId() = default;
+    constexpr explicit UniformId(std::string_view name) : value(Hash(name)) {}
+
+    static constexpr uint32_t Hash(std::string_view name) {
+      uint32_t hash = 2166136261u;
+      for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+
+    constexpr bool operator==(const UniformId&) const = default;
+    constexpr auto operator<=>(const UniformId&) const = default;
+  };
+
+  inline namespace literals {
+    consteval UniformId operator""_uid(const char* name, size_t size) {
+      return UniformId(std::string_view(name, size));
+    }
+  }
+
+}
+
+#endif
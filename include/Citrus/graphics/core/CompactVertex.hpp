@@ -0,0 +1,133 @@
+#ifndef CITRUS_GRAPHICS_COMPACTVERTEX_HPP
+#define CITRUS_GRAPHICS_COMPACTVERTEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "color.hpp"
+#include "VertexLayout.hpp"
+#include "Citrus/sys/Vector3.hpp"
+
+// Smaller alternatives to Vertex for geometry where bandwidth matters more than precision.
+// Every type reads its position at location 0 and its color at location 1 like Vertex, so the same shaders
+// draw them. Integer components are normalized by the vertex fetch, shaders still see floats
+
+namespace citrus {
+  // 8 bit per channel color, normalized to [0, 1] in the shader
+  struct Rgba8 {
+    Rgba8() = default;
+    Rgba8(uint8_t _r, uint8_t _g, uint8_t _b, uint8_t _a = 255) : r(_r), g(_g), b(_b), a(_a) {}
+    explicit Rgba8(Color color) {
+      const auto rgba = color.asUint8Rgba();
+      r = rgba[0];
+      g = rgba[1];
+      b = rgba[2];
+      a = rgba[3];
+    }
+    uint8_t r = 255, g = 255, b = 255, a = 255;
+  };
+  template <>
+  struct VertexAttribTraits<Rgba8> {
+    static inline constexpr uint8_t COMPONENTS = 4;
+    static inline constexpr VertexAttribType TYPE = VertexAttribType::UINT8;
+  };
+
+  // Converts to an IEEE 754 half, rounding to nearest even. Values past the half range become infinities
+  constexpr uint16_t PackHalf(float value) {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+      return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0); // Infinity or a quiet NaN
+    }
+    if (magnitude >= 0x477FF000) {
+      return sign | 0x7C00; // Rounds past 65504
+    }
+    if (magnitude < 0x38800000) {
+      // Below the smallest normal half, the result is subnormal or zero
+      if (magnitude < 0x33000000) {
+        return sign;
+      }
+      const uint32_t shift = 126 - (magnitude >> 23);
+      const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+      uint32_t half = mantissa >> shift;
+      const uint32_t remainder = mantissa & ((1u << shift) - 1);
+      const uint32_t halfway = 1u << (shift - 1);
+      if (remainder > halfway || (remainder == halfway && (half & 1))) {
+        half++;
+      }
+      return sign | half;
+    }
+    // Rebias the exponent from 127 to 15 and drop 13 mantissa bits, a carry rolls into the exponent
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    const uint32_t remainder = magnitude & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+      half++;
+    }
+    return sign | half;
+  }
+  inline constexpr uint16_t HALF_ONE = 0x3C00;
+
+  // Maps [-1, 1] to a signed normalized 16 bit value
+  inline int16_t PackSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+  }
+
+  // Packs a unit vector as signed normalized 10 bit components, w is 0
+  inline uint32_t PackNormal(Vector3f normal) {
+    const auto pack = [](float value) {
+      return static_cast<uint32_t>(std::lround(std::clamp(value, -1.f, 1.f) * 511.f)) & 0x3FF;
+    };
+    return pack(normal.x) | pack(normal.y) << 10 | pack(normal.z) << 20;
+  }
+
+  // Full precision position with an 8 bit color, 16 bytes against the 28 of Vertex
+  struct ByteColorVertex {
+    ByteColorVertex() : position() {}
+    ByteColorVertex(Rgba8 _color, Vector3f pos) : position(pos), color(_color) {}
+    Vector3f position;
+    Rgba8 color;
+  };
+
+  // Half float position with an 8 bit color, 12 bytes. Halves keep 11 significant bits,
+  // enough for positions within a few thousand units of the origin
+  struct HalfVertex {
+    HalfVertex() = default;
+    HalfVertex(Rgba8 _color, Vector3f pos)
+        : position{PackHalf(pos.x), PackHalf(pos.y), PackHalf(pos.z), HALF_ONE}, color(_color) {}
+    std::array<uint16_t, 4> position {0, 0, 0, HALF_ONE}; // w is 1, the padding keeps the color 4 byte aligned
+    Rgba8 color;
+  };
+
+  // Position quantized to [-1, 1], an 8 bit color and a packed normal read at location 2, 16 bytes.
+  // Meshes are quantized within their bounds and scaled back with DrawParams::scale
+  struct PackedVertex {
+    PackedVertex() = default;
+    PackedVertex(Rgba8 _color, Vector3f pos, Vector3f _normal = {0.f, 0.f, 1.f})
+        : position{PackSnorm16(pos.x), PackSnorm16(pos.y), PackSnorm16(pos.z), INT16_MAX}, color(_color), normal(PackNormal(_normal)) {}
+    std::array<int16_t, 4> position {0, 0, 0, INT16_MAX}; // w is 1
+    Rgba8 color;
+    uint32_t normal = 0;
+  };
+
+  template <>
+  struct VertexFormatOf<ByteColorVertex> : VertexLayout<ByteColorVertex, CITRUS_VERTEX_ATTRIB(ByteColorVertex, position, 0),
+                                                        CITRUS_VERTEX_ATTRIB(ByteColorVertex, color, 1, VertexAttribMode::NORMALIZED)> {};
+  template <>
+  struct VertexFormatOf<HalfVertex>
+      : VertexLayout<HalfVertex, CITRUS_VERTEX_ATTRIB(HalfVertex, position, 0, VertexAttribMode::FLOAT, VertexAttribType::HALF_FLOAT),
+                     CITRUS_VERTEX_ATTRIB(HalfVertex, color, 1, VertexAttribMode::NORMALIZED)> {};
+  template <>
+  struct VertexFormatOf<PackedVertex>
+      : VertexLayout<PackedVertex, CITRUS_VERTEX_ATTRIB(PackedVertex, position, 0, VertexAttribMode::NORMALIZED),
+                     CITRUS_VERTEX_ATTRIB(PackedVertex, color, 1, VertexAttribMode::NORMALIZED),
+                     CITRUS_VERTEX_ATTRIB(PackedVertex, normal, 2, VertexAttribMode::NORMALIZED, VertexAttribType::INT_2_10_10_10)> {};
+
+  static_assert(sizeof(ByteColorVertex) == 16 && sizeof(HalfVertex) == 12 && sizeof(PackedVertex) == 16);
+}
+
+#endif
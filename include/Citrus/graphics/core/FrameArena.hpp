@@ -0,0 +1,65 @@
+#ifndef CITRUS_GRAPHICS_FRAMEARENA_HPP
+#define CITRUS_GRAPHICS_FRAMEARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace citrus {
+  // Linear allocator for memory that only lives until the end of a frame.
+  // Deallocation is a no-op, everything is released at once by reset(). When a frame needs more than one block
+  // the blocks are merged into a single one on reset, so a frame that doesn't outgrow the previous ones never touches the heap
+  class FrameArena : public std::pmr::memory_resource {
+    public:
+    static inline constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit FrameArena(size_t initial_capacity = DEFAULT_CAPACITY);
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Copies the values into the arena
+    template <typename T>
+    std::span<T> copy(std::span<const T> values) {
+      if (values.empty()) {
+        return {};
+      }
+      T* data = static_cast<T*>(this->allocate(values.size_bytes(), alignof(T)));
+      std::uninitialized_copy(values.begin(), values.end(), data);
+      return std::span<T>(data, values.size());
+    }
+
+    void reset();
+
+    // Heap allocations made since the last reset
+    size_t getUpstreamAllocationCount() const noexcept {
+      return upstream_allocations_;
+    }
+    // Bytes handed out since the last reset, alignment padding included
+    size_t getBytesUsed() const noexcept {
+      return bytes_used_;
+    }
+    size_t getCapacity() const noexcept;
+
+    private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+      return this == &other;
+    }
+    void addBlock(size_t size);
+
+    struct Block {
+      std::unique_ptr<std::byte[]> data;
+      size_t size = 0;
+    };
+    std::vector<Block> blocks_;
+    size_t block_offset_ = 0; // Offset of the next free byte in the last block
+    size_t bytes_used_ = 0;
+    size_t peak_bytes_used_ = 0;
+    size_t upstream_allocations_ = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CITRUS_GRAPHICS_INDEXBUFFER_HPP
+#define CITRUS_GRAPHICS_INDEXBUFFER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+namespace citrus {
+  enum class IndexType : uint8_t { UINT16, UINT32 };
+
+  // Indices into a VertexBuffer, stored as either 16 or 32 bit values
+  class IndexBuffer {
+    public:
+    IndexBuffer() = default;
+    // Stored as 16 bit indices whenever they all fit
+    IndexBuffer(std::initializer_list<uint32_t> indices) {
+      if (std::all_of(indices.begin(), indices.end(), [](uint32_t index) { return index <= UINT16_MAX; })) {
+        indices16_.assign(indices.begin(), indices.end());
+      } else {
+        type_ = IndexType::UINT32;
+        indices32_.assign(indices.begin(), indices.end());
+      }
+    }
+    IndexBuffer(std::span<const uint16_t> indices) : type_(IndexType::UINT16), indices16_(indices.begin(), indices.end()) {}
+    IndexBuffer(std::span<const uint32_t> indices) : type_(IndexType::UINT32), indices32_(indices.begin(), indices.end()) {}
+
+    IndexType getType() const noexcept {
+      return type_;
+    }
+    size_t size() const noexcept {
+      return type_ == IndexType::UINT16 ? indices16_.size() : indices32_.size();
+    }
+    bool isEmpty() const noexcept {
+      return size() == 0;
+    }
+    std::span<const uint16_t> getIndices16() const noexcept {
+      return indices16_;
+    }
+    std::span<const uint32_t> getIndices32() const noexcept {
+      return indices32_;
+    }
+
+    private:
+    IndexType type_ = IndexType::UINT16;
+    std::vector<uint16_t> indices16_;
+    std::vector<uint32_t> indices32_;
+  };
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef CITRUS_GRAPHICS_INSTANCEDATA_HPP
+#define CITRUS_GRAPHICS_INSTANCEDATA_HPP
+
+#include <cstdint>
+
+#include "color.hpp"
+#include "Citrus/sys/Vector3.hpp"
+
+namespace citrus {
+  // Per instance attributes for instanced draws, also used as the per draw parameters of regular draws.
+  // Shaders read them at locations 8 (offset), 9 (scale), 10 (color) and 11 (material id, an unsigned integer)
+  struct InstanceData {
+    InstanceData() : offset(0.f, 0.f, 0.f), scale(1.f, 1.f, 1.f), color(1.f, 1.f, 1.f, 1.f) {}
+    InstanceData(Vector3f _offset, Vector3f _scale, Color _color, uint32_t _material_id = 0)
+        : offset(_offset), scale(_scale), color(_color), material_id(_material_id) {}
+    explicit InstanceData(Color _color) : offset(0.f, 0.f, 0.f), scale(1.f, 1.f, 1.f), color(_color) {}
+    Vector3f offset;
+    Vector3f scale;
+    Color color;
+    uint32_t material_id = 0;
+  };
+}
+
+#endif
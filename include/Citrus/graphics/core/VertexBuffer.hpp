@@ -0,0 +1,175 @@
+#ifndef CITRUS_GRAPHICS_VERTEXBUFFER_HPP
+#define CITRUS_GRAPHICS_VERTEXBUFFER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace citrus {
+  // Non-owning view of vertices, what the draw calls take. Draws copy the vertices when they are recorded,
+  // so a view of a temporary buffer is fine as an argument, but it must not outlive the buffer otherwise
+  template <typename TVertex>
+  class BasicVertexView {
+    public:
+    BasicVertexView() = default;
+    BasicVertexView(std::span<const TVertex> vertices) : vertices_(vertices) {}
+
+    std::span<const TVertex> getVertices() const noexcept {
+      return vertices_;
+    }
+    size_t size() const noexcept {
+      return vertices_.size();
+    }
+    bool isEmpty() const noexcept {
+      return vertices_.empty();
+    }
+
+    private:
+    std::span<const TVertex> vertices_;
+  };
+
+  // Owning vertex storage. Up to InlineN vertices live inside the object, past that they move to a vector
+  // using Allocator, which may be a std::pmr allocator backed by any memory resource (see PmrVertexBuffer).
+  // Vertices are uploaded byte by byte, so the type must be trivially copyable
+  template <typename TVertex, size_t InlineN = 16, typename Allocator = std::allocator<TVertex>>
+  class BasicVertexBuffer {
+    static_assert(std::is_trivially_copyable_v<TVertex> && std::is_trivially_destructible_v<TVertex>);
+
+    public:
+    using value_type = TVertex;
+    using allocator_type = Allocator;
+    static inline constexpr size_t SMALL_BUFFER_MAX_SIZE = InlineN;
+
+    BasicVertexBuffer() = default;
+    explicit BasicVertexBuffer(const Allocator& allocator) : heap_(allocator) {}
+    BasicVertexBuffer(std::initializer_list<TVertex> vertices, const Allocator& allocator = Allocator()) : heap_(allocator) {
+      this->append(std::span<const TVertex>(vertices.begin(), vertices.size()));
+    }
+    BasicVertexBuffer(std::span<const TVertex> vertices, const Allocator& allocator = Allocator()) : heap_(allocator) {
+      this->append(vertices);
+    }
+    BasicVertexBuffer(const TVertex* vertices, size_t size, const Allocator& allocator = Allocator()) : heap_(allocator) {
+      this->append(std::span<const TVertex>(vertices, size));
+    }
+    // Takes over the vector's storage without copying the vertices
+    explicit BasicVertexBuffer(std::vector<TVertex, Allocator>&& vertices) : heap_(std::move(vertices)), on_heap_(true) {}
+
+    BasicVertexBuffer(const BasicVertexBuffer&) = delete;
+    BasicVertexBuffer& operator=(const BasicVertexBuffer&) = delete;
+    BasicVertexBuffer(BasicVertexBuffer&& other) noexcept : heap_(std::move(other.heap_)) {
+      this->takeInline(other);
+    }
+    BasicVertexBuffer& operator=(BasicVertexBuffer&& other) noexcept(std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value ||
+                                                                     std::allocator_traits<Allocator>::is_always_equal::value) {
+      if (this == &other) {
+        return *this;
+      }
+      heap_ = std::move(other.heap_);
+      this->takeInline(other);
+      return *this;
+    }
+    ~BasicVertexBuffer() = default;
+
+    void append(const TVertex& vertex) {
+      this->append(std::span<const TVertex>(&vertex, 1));
+    }
+    // The vertices must not point into this buffer
+    void append(std::span<const TVertex> vertices) {
+      if (!on_heap_ && inline_size_ + vertices.size() <= InlineN) {
+        std::memcpy(static_cast<void*>(this->inlineData() + inline_size_), vertices.data(), vertices.size_bytes());
+        inline_size_ += vertices.size();
+        return;
+      }
+      this->moveToHeap(this->size() + vertices.size());
+      heap_.insert(heap_.end(), vertices.begin(), vertices.end());
+    }
+    void reserve(size_t capacity) {
+      if (capacity > this->capacity()) {
+        this->moveToHeap(capacity);
+      }
+    }
+    // Keeps the heap storage, if any, for the next vertices
+    void clear() noexcept {
+      heap_.clear();
+      inline_size_ = 0;
+    }
+
+    std::span<TVertex> getVertices() noexcept {
+      return std::span<TVertex>(this->data(), this->size());
+    }
+    std::span<const TVertex> getVertices() const noexcept {
+      return std::span<const TVertex>(this->data(), this->size());
+    }
+    BasicVertexView<TVertex> getView() const noexcept {
+      return this->getVertices();
+    }
+    operator BasicVertexView<TVertex>() const noexcept {
+      return this->getVertices();
+    }
+    size_t size() const noexcept {
+      return on_heap_ ? heap_.size() : inline_size_;
+    }
+    size_t capacity() const noexcept {
+      return on_heap_ ? heap_.capacity() : InlineN;
+    }
+    bool isEmpty() const noexcept {
+      return this->size() == 0;
+    }
+    allocator_type get_allocator() const noexcept {
+      return heap_.get_allocator();
+    }
+
+    private:
+    TVertex* data() noexcept {
+      return on_heap_ ? heap_.data() : this->inlineData();
+    }
+    const TVertex* data() const noexcept {
+      return on_heap_ ? heap_.data() : this->inlineData();
+    }
+    TVertex* inlineData() noexcept {
+      return reinterpret_cast<TVertex*>(inline_.data());
+    }
+    const TVertex* inlineData() const noexcept {
+      return reinterpret_cast<const TVertex*>(inline_.data());
+    }
+    void moveToHeap(size_t capacity) {
+      if (on_heap_) {
+        heap_.reserve(capacity);
+        return;
+      }
+      heap_.reserve(std::max(capacity, 2 * InlineN));
+      heap_.assign(this->inlineData(), this->inlineData() + inline_size_);
+      on_heap_ = true;
+      inline_size_ = 0;
+    }
+    // Called once other's heap storage has been moved into this buffer
+    void takeInline(BasicVertexBuffer& other) noexcept {
+      on_heap_ = other.on_heap_;
+      inline_size_ = other.inline_size_;
+      if (!on_heap_) {
+        std::memcpy(inline_.data(), other.inline_.data(), inline_size_ * sizeof(TVertex));
+      }
+      other.heap_.clear();
+      other.on_heap_ = false;
+      other.inline_size_ = 0;
+    }
+
+    std::vector<TVertex, Allocator> heap_; // Holds the vertices once they outgrow the inline storage
+    alignas(TVertex) std::array<std::byte, InlineN * sizeof(TVertex)> inline_;
+    size_t inline_size_ = 0;
+    bool on_heap_ = false;
+  };
+
+  template <typename TVertex, size_t InlineN = 16>
+  using PmrVertexBuffer = BasicVertexBuffer<TVertex, InlineN, std::pmr::polymorphic_allocator<TVertex>>;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CITRUS_GRAPHICS_VERTEXFORMAT_HPP
+#define CITRUS_GRAPHICS_VERTEXFORMAT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace citrus {
+  // Storage type of a vertex attribute component
+  enum class VertexAttribType : uint8_t {
+    FLOAT,
+    HALF_FLOAT,
+    INT8,
+    UINT8,
+    INT16,
+    UINT16,
+    INT32,
+    UINT32,
+    INT_2_10_10_10 // Four signed components packed in 32 bits, x in the low bits, always read as 4 components
+  };
+
+  // How the shader sees an attribute: FLOAT converts integers as is, NORMALIZED maps them to [0, 1] or [-1, 1]
+  // and INTEGER keeps them as integers for int/uint shader inputs
+  enum class VertexAttribMode : uint8_t { FLOAT, NORMALIZED, INTEGER };
+
+  struct VertexAttribute {
+    uint8_t location = 0;
+    uint8_t components = 0;
+    VertexAttribType type = VertexAttribType::FLOAT;
+    VertexAttribMode mode = VertexAttribMode::FLOAT;
+    uint16_t offset = 0; // In bytes from the start of the vertex
+
+    constexpr bool operator==(const VertexAttribute&) const = default;
+  };
+
+  // Memory layout of a vertex type, the renderer builds its vertex arrays from it
+  struct VertexFormat {
+    static inline constexpr size_t MAX_ATTRIBUTES = 8;
+
+    uint16_t stride = 0;
+    uint8_t attribute_count = 0;
+    std::array<VertexAttribute, MAX_ATTRIBUTES> attributes {};
+
+    constexpr std::span<const VertexAttribute> getAttributes() const noexcept {
+      return std::span<const VertexAttribute>(attributes.data(), attribute_count);
+    }
+    constexpr bool operator==(const VertexFormat&) const = default;
+  };
+
+  // Format of a vertex type, specialize it with a `static inline constexpr VertexFormat value`, usually by
+  // deriving from a VertexLayout (see VertexLayout.hpp). The renderer keeps a pointer to value, so a type
+  // always maps to the same format object
+  template <typename TVertex>
+  struct VertexFormatOf;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef CITRUS_GRAPHICS_VERTEXLAYOUT_HPP
+#define CITRUS_GRAPHICS_VERTEXLAYOUT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "color.hpp"
+#include "VertexFormat.hpp"
+#include "Citrus/sys/Vector2.hpp"
+#include "Citrus/sys/Vector3.hpp"
+
+namespace citrus {
+  // Component count and type of a member type, specialize it for other types used as attributes
+  template <typename T>
+  struct VertexAttribTraits;
+
+  template <typename T, VertexAttribType Type>
+  struct ScalarVertexAttribTraits {
+    static inline constexpr uint8_t COMPONENTS = 1;
+    static inline constexpr VertexAttribType TYPE = Type;
+  };
+  template <> struct VertexAttribTraits<float> : ScalarVertexAttribTraits<float, VertexAttribType::FLOAT> {};
+  template <> struct VertexAttribTraits<int8_t> : ScalarVertexAttribTraits<int8_t, VertexAttribType::INT8> {};
+  template <> struct VertexAttribTraits<uint8_t> : ScalarVertexAttribTraits<uint8_t, VertexAttribType::UINT8> {};
+  template <> struct VertexAttribTraits<int16_t> : ScalarVertexAttribTraits<int16_t, VertexAttribType::INT16> {};
+  template <> struct VertexAttribTraits<uint16_t> : ScalarVertexAttribTraits<uint16_t, VertexAttribType::UINT16> {};
+  template <> struct VertexAttribTraits<int32_t> : ScalarVertexAttribTraits<int32_t, VertexAttribType::INT32> {};
+  template <> struct VertexAttribTraits<uint32_t> : ScalarVertexAttribTraits<uint32_t, VertexAttribType::UINT32> {};
+
+  template <typename T, size_t N>
+  struct VertexAttribTraits<std::array<T, N>> {
+    static inline constexpr uint8_t COMPONENTS = N * VertexAttribTraits<T>::COMPONENTS;
+    static inline constexpr VertexAttribType TYPE = VertexAttribTraits<T>::TYPE;
+  };
+  template <typename T>
+  struct VertexAttribTraits<Vector2<T>> {
+    static inline constexpr uint8_t COMPONENTS = 2;
+    static inline constexpr VertexAttribType TYPE = VertexAttribTraits<T>::TYPE;
+  };
+  template <typename T>
+  struct VertexAttribTraits<Vector3<T>> {
+    static inline constexpr uint8_t COMPONENTS = 3;
+    static inline constexpr VertexAttribType TYPE = VertexAttribTraits<T>::TYPE;
+  };
+  template <>
+  struct VertexAttribTraits<Color> {
+    static inline constexpr uint8_t COMPONENTS = 4;
+    static inline constexpr VertexAttribType TYPE = VertexAttribType::FLOAT;
+  };
+
+  constexpr size_t VertexAttribTypeSize(VertexAttribType type) {
+    switch (type) {
+      case VertexAttribType::INT8:
+      case VertexAttribType::UINT8:
+        return 1;
+      case VertexAttribType::HALF_FLOAT:
+      case VertexAttribType::INT16:
+      case VertexAttribType::UINT16:
+        return 2;
+      default:
+        return 4;
+    }
+  }
+
+  // One member of a vertex read as an attribute. The type defaults to the one of the member's components,
+  // override it for members stored in another format, like half floats kept in uint16_t
+  template <typename TMember, uint8_t Location, VertexAttribMode Mode = VertexAttribMode::FLOAT,
+            VertexAttribType Type = VertexAttribTraits<TMember>::TYPE>
+  struct Attrib {
+    using Member = TMember;
+    static inline constexpr uint8_t LOCATION = Location;
+    static inline constexpr VertexAttribMode MODE = Mode;
+    static inline constexpr VertexAttribType TYPE = Type;
+    // Packed types always hold 4 components in a single 32 bit value
+    static inline constexpr uint8_t COMPONENTS = Type == VertexAttribType::INT_2_10_10_10 ? 4 : VertexAttribTraits<TMember>::COMPONENTS;
+
+    static_assert(Location < 8 || Location > 11, "Locations 8 to 11 are taken by the draw parameters");
+    static_assert(Location < 16, "GL only guarantees 16 attribute locations");
+    static_assert(COMPONENTS >= 1 && COMPONENTS <= 4, "Attributes hold 1 to 4 components");
+    static_assert(sizeof(TMember) == (Type == VertexAttribType::INT_2_10_10_10 ? 4 : COMPONENTS * VertexAttribTypeSize(Type)),
+                  "The attribute type doesn't match the size of the member");
+    static_assert(Mode == VertexAttribMode::FLOAT || (Type != VertexAttribType::FLOAT && Type != VertexAttribType::HALF_FLOAT),
+                  "Only integer attributes can be normalized or read as integers");
+    static_assert(Mode != VertexAttribMode::INTEGER || Type != VertexAttribType::INT_2_10_10_10,
+                  "Packed attributes can't be read as integers");
+  };
+
+  // An Attrib along with the real offset of the member it reads, made by CITRUS_VERTEX_ATTRIB
+  template <size_t Offset, typename TAttrib>
+  struct VertexMember : TAttrib {
+    static inline constexpr size_t OFFSET = Offset;
+  };
+
+  namespace detail {
+    constexpr size_t AlignUp(size_t value, size_t alignment) {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Lays the members out the way the compiler does for a standard layout struct declaring them in order
+    template <typename... TAttribs>
+    consteval VertexFormat MakeVertexFormat() {
+      VertexFormat format;
+      size_t offset = 0;
+      size_t alignment = 1;
+      ((offset = AlignUp(offset, alignof(typename TAttribs::Member)),
+        format.attributes[format.attribute_count++] = VertexAttribute{TAttribs::LOCATION, TAttribs::COMPONENTS, TAttribs::TYPE, TAttribs::MODE, static_cast<uint16_t>(offset)},
+        offset += sizeof(typename TAttribs::Member),
+        alignment = std::max(alignment, alignof(typename TAttribs::Member))), ...);
+      format.stride = static_cast<uint16_t>(AlignUp(offset, alignment));
+      return format;
+    }
+
+    template <typename... TMembers>
+    consteval bool HasMemberOffsets(const VertexFormat& format) {
+      size_t i = 0;
+      return ((format.attributes[i++].offset == TMembers::OFFSET) && ...);
+    }
+
+    consteval bool HasUniqueLocations(const VertexFormat& format) {
+      for (size_t i = 0; i < format.attribute_count; i++) {
+        for (size_t j = i + 1; j < format.attribute_count; j++) {
+          if (format.attributes[i].location == format.attributes[j].location) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+  }
+
+  // Describes a vertex struct at compile time, listing every member in declaration order once the struct is complete:
+  //   struct SpriteVertex {
+  //     Vector2f position;
+  //     Rgba8 color;
+  //   };
+  //   template <>
+  //   struct VertexFormatOf<SpriteVertex> : VertexLayout<SpriteVertex, CITRUS_VERTEX_ATTRIB(SpriteVertex, position, 0),
+  //                                                     CITRUS_VERTEX_ATTRIB(SpriteVertex, color, 1, VertexAttribMode::NORMALIZED)> {};
+  // The offsets worked out from the list are checked against the members' real ones
+  template <typename TVertex, typename... TMembers>
+  struct VertexLayout {
+    static_assert(sizeof...(TMembers) > 0 && sizeof...(TMembers) <= VertexFormat::MAX_ATTRIBUTES);
+
+    static inline constexpr VertexFormat value = detail::MakeVertexFormat<TMembers...>();
+
+    static_assert(std::is_standard_layout_v<TVertex> && std::is_trivially_copyable_v<TVertex>,
+                  "Vertices are copied to the GPU byte by byte");
+    static_assert(detail::HasMemberOffsets<TMembers...>(value), "The attributes must list the members of the vertex in declaration order");
+    static_assert(value.stride == sizeof(TVertex), "The attributes must list every member of the vertex");
+    static_assert(detail::HasUniqueLocations(value), "Two attributes of the vertex share a location");
+  };
+}
+
+// Attribute reading a member of a vertex struct, the arguments after the location are the ones of Attrib
+#define CITRUS_VERTEX_ATTRIB(Struct, member, ...) \
+  ::citrus::VertexMember<offsetof(Struct, member), ::citrus::Attrib<decltype(Struct::member), __VA_ARGS__>>
+
+#endif
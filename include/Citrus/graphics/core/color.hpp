@@ -16,7 +16,7 @@ namespace citrus {
       return Color(r, g, b, a);
     }
     ~Color() = default;
-    std::array<float, 4> asFloatRgba() noexcept {
+    std::array<float, 4> asFloatRgba() const noexcept {
       return std::array<float, 4>{r_, g_, b_, a_};
     }
     std::array<uint8_t, 4> asUint8Rgba() const noexcept {
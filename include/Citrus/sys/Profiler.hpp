@@ -0,0 +1,59 @@
+#ifndef CITRUS_SYS_PROFILER_HPP
+#define CITRUS_SYS_PROFILER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace citrus {
+  // CPU trace capture. Zones are recorded into a per thread buffer without locking and only while a capture is
+  // running, the capture can then be written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+  // Zones are placed with CITRUS_PROFILE_SCOPE, they compile to nothing unless CITRUS_ENABLE_PROFILING is defined
+  class Profiler {
+    public:
+    static inline constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+    Profiler() = delete;
+
+    // Starts a new capture, dropping the previous one
+    static void beginCapture();
+    static void endCapture();
+    static bool isCapturing() noexcept;
+    // Writes the last capture, must not be called while threads are still recording into it
+    static void writeChromeTrace(const std::filesystem::path& path);
+    // Zones lost because a thread filled its buffer during the capture
+    static uint64_t getDroppedEventCount() noexcept;
+
+    static void recordZone(const char* name, uint64_t start_ns, uint64_t end_ns);
+    static uint64_t now() noexcept; // Nanoseconds on the profiler clock
+  };
+
+  // Records the time between its construction and destruction as a zone
+  class ProfileZone {
+    public:
+    explicit ProfileZone(const char* name) : name_(name), start_ns_(Profiler::isCapturing() ? Profiler::now() : 0) {}
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+    ~ProfileZone() {
+      if (start_ns_ != 0) {
+        Profiler::recordZone(name_, start_ns_, Profiler::now());
+      }
+    }
+
+    private:
+    const char* name_;
+    uint64_t start_ns_;
+  };
+}
+
+#define CITRUS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define CITRUS_PROFILE_CONCAT(a, b) CITRUS_PROFILE_CONCAT_IMPL(a, b)
+
+// Profiles the rest of the enclosing scope, name must be a string literal
+#ifdef CITRUS_ENABLE_PROFILING
+#define CITRUS_PROFILE_SCOPE(name) ::citrus::ProfileZone CITRUS_PROFILE_CONCAT(citrus_profile_zone_, __LINE__)(name)
+#else
+#define CITRUS_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif
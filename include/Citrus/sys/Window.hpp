@@ -1,6 +1,9 @@
 #ifndef CITRUS_SYS_WINDOW_HPP
 #define CITRUS_SYS_WINDOW_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string_view>
 #include <variant>
 #include <optional>
@@ -32,7 +35,10 @@ namespace citrus {
         citrus::Key key;
         citrus::KeyModifier key_modifier;
       };
-      using EventsVariant = std::variant<Closed, KeyDown, KeyUp, KeyRepeat>;
+      struct Resized {
+        Vector2i size;
+      };
+      using EventsVariant = std::variant<Closed, KeyDown, KeyUp, KeyRepeat, Resized>;
       Event() = delete;
       Event(const Event& cpy) : internal_evt_(cpy.internal_evt_) {}
       Event(EventsVariant&& evt) : internal_evt_(std::move(evt)) {}
@@ -48,6 +54,15 @@ namespace citrus {
       EventsVariant internal_evt_;
     };
     
+    // How getEvent gets events from the system
+    enum class EventMode : uint8_t {
+      POLL, // Never blocks, for applications drawing every frame
+      // The first getEvent of a frame sleeps until there is something to draw: an event, a damaged window, a call to
+      // requestRedraw or the deadline given to requestRedrawAt. Following calls only poll, once they run out of
+      // events the application draws and the next call sleeps again
+      WAIT
+    };
+
     Window() = delete;
 
     explicit Window(std::string_view name, Vector2u size, bool isResizable = true, bool isDecorated = true , bool createOpenGlContext = true, bool isFullsceen = false,Monitor* monitor = nullptr);
@@ -55,6 +70,18 @@ namespace citrus {
     Vector2i getSize() const;
 
     std::optional<Event> getEvent();  
+
+    void setEventMode(EventMode mode) noexcept {
+      event_mode_ = mode;
+    }
+    EventMode getEventMode() const noexcept {
+      return event_mode_;
+    }
+    // Wakes a waiting getEvent so the application draws another frame, can be called from any thread
+    void requestRedraw();
+    // Same as requestRedraw once the time point is reached, for animations. Only the earliest pending deadline is
+    // kept, can be called from any thread
+    void requestRedrawAt(std::chrono::steady_clock::time_point time);
     
     void addEventToQueue(Event&& evt);
 
@@ -73,7 +100,15 @@ namespace citrus {
     ~Window();
 
     private:
+    static inline constexpr int64_t NO_REDRAW_DEADLINE = INT64_MAX;
+
+    void waitForRedraw();
+
     std::queue<Event> evt_queue_;
+    EventMode event_mode_ = EventMode::POLL;
+    bool frame_started_ = false; // An event was handed out since the last wait, the next empty queue ends the frame
+    std::atomic<bool> redraw_requested_ = false;
+    std::atomic<int64_t> redraw_deadline_ = NO_REDRAW_DEADLINE; // In steady clock nanoseconds
     Monitor* monitor_;
     GLFWwindow* glfw_window_;
   };
@@ -4,6 +4,7 @@
 #include "Globals.hpp"
 #include "Keyboard.hpp"
 #include "Monitor.hpp"
+#include "Profiler.hpp"
 #include "Vector2.hpp"
 #include "Window.hpp"
 
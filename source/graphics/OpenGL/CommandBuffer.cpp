@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include "Citrus/graphics/OpenGL/CommandBuffer.hpp"
+
+namespace citrus::opengl {
+
+  DrawCommand CommandBuffer::makeCommand(VertexView vertices, ShaderProgram& shader_program, DrawOrder order) {
+    DrawCommand command;
+    command.sort_key = MakeSortKey(order, shader_program.getId());
+    command.shader_program = std::addressof(shader_program);
+    command.vertices = std::as_bytes(recording_->arena.copy<Vertex>(vertices.getVertices()));
+    return command;
+  }
+
+  template <typename TIndex>
+  static bool IndicesInRange(std::span<const TIndex> indices, size_t vertex_count) {
+    return std::all_of(indices.begin(), indices.end(), [vertex_count](TIndex index) {
+      return index < vertex_count;
+    });
+  }
+
+  // Every indexed draw passes through here, batching and the command lists' meshes rebase indices without checking them
+  void CommandBuffer::copyIndices(DrawCommand& command, const IndexBuffer& indices) {
+    const size_t vertex_count = command.getVertexCount();
+    const bool in_range = indices.getType() == IndexType::UINT16 ? IndicesInRange(indices.getIndices16(), vertex_count)
+                                                                 : IndicesInRange(indices.getIndices32(), vertex_count);
+    if (!in_range) {
+      throw std::runtime_error("Attempted to draw with an index past the draw's vertices");
+    }
+    command.indexed = true;
+    command.index_type = indices.getType();
+    if (indices.getType() == IndexType::UINT16) {
+      command.indices = std::as_bytes(recording_->arena.copy<uint16_t>(indices.getIndices16()));
+    } else {
+      command.indices = std::as_bytes(recording_->arena.copy<uint32_t>(indices.getIndices32()));
+    }
+  }
+
+  void CommandBuffer::draw(VertexView vertices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    DrawCommand command = this->makeCommand(vertices, shader_program, order);
+    command.pre_draw_func = pre_draw_func;
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    DrawCommand command = this->makeCommand(vertices, shader_program, order);
+    this->copyIndices(command, indices);
+    command.pre_draw_func = pre_draw_func;
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::draw(VertexView vertices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    DrawCommand command = this->makeCommand(vertices, shader_program, order);
+    command.params = params;
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    DrawCommand command = this->makeCommand(vertices, shader_program, order);
+    this->copyIndices(command, indices);
+    command.params = params;
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::drawVertices(const VertexFormat& format, std::span<const std::byte> vertices, const IndexBuffer* indices,
+                                   ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    DrawCommand command;
+    command.sort_key = MakeSortKey(order, shader_program.getId());
+    command.shader_program = std::addressof(shader_program);
+    command.vertex_format = &format;
+    // Only ever copied into the vertex stream byte by byte, no need to keep the vertex type's alignment
+    command.vertices = recording_->arena.copy<std::byte>(vertices);
+    if (indices) {
+      this->copyIndices(command, *indices);
+    }
+    command.params = params;
+    this->recording_->commands.push_back(command);
+  }
+
+  std::byte* CommandBuffer::recordVertices(const VertexFormat& format, size_t size, size_t alignment, ShaderProgram& shader_program,
+                                          const DrawParams& params, DrawOrder order) {
+    if (size == 0) {
+      return nullptr;
+    }
+    // Starting the lifetime of a byte array lets the caller write vertices into it without constructing them first
+    std::byte* memory = new (recording_->arena.allocate(size, alignment)) std::byte[size];
+    DrawCommand command;
+    command.sort_key = MakeSortKey(order, shader_program.getId());
+    command.shader_program = std::addressof(shader_program);
+    command.vertex_format = &format;
+    command.vertices = std::span<const std::byte>(memory, size);
+    command.params = params;
+    this->recording_->commands.push_back(command);
+    return memory;
+  }
+
+  void CommandBuffer::draw(DrawBatch&& batch, PreDrawFunc pre_draw_func, DrawOrder order) {
+    if (!batch.shader_program) {
+      throw std::runtime_error("Attempted to draw a batch without a shader program");
+    }
+    if (!batch.index_buffers.empty() && batch.index_buffers.size() != batch.vertex_buffers.size()) {
+      throw std::runtime_error("An indexed batch needs one index buffer per vertex buffer");
+    }
+    if (!batch.draw_params.empty() && batch.draw_params.size() != batch.vertex_buffers.size()) {
+      throw std::runtime_error("A batch with draw parameters needs one set of parameters per vertex buffer");
+    }
+    if (!batch.instances.empty() && batch.vertex_buffers.size() != 1) {
+      throw std::runtime_error("An instanced batch needs exactly one vertex buffer");
+    }
+    // Every buffer becomes a command sharing the same key, the stable sort keeps them together
+    for (size_t i = 0; i < batch.vertex_buffers.size(); i++) {
+      DrawCommand command = this->makeCommand(batch.vertex_buffers[i], *batch.shader_program, order);
+      command.merge = i == 0 ? DrawCommand::Merge::NONE : DrawCommand::Merge::PREVIOUS;
+      command.pre_draw_func = pre_draw_func;
+      if (!batch.index_buffers.empty()) {
+        this->copyIndices(command, batch.index_buffers[i]);
+      }
+      if (!batch.draw_params.empty()) {
+        command.params = batch.draw_params[i];
+      }
+      if (!batch.instances.empty()) {
+        command.instances = recording_->arena.copy<InstanceData>(batch.instances);
+      }
+      this->recording_->commands.push_back(command);
+    }
+  }
+
+  void CommandBuffer::drawInstanced(VertexView vertices, std::span<const InstanceData> instances, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    if (instances.empty()) {
+      return;
+    }
+    // Instanced batches are never merged, every call is a single glDrawArraysInstanced
+    DrawCommand command = this->makeCommand(vertices, shader_program, order);
+    command.merge = DrawCommand::Merge::NONE;
+    command.pre_draw_func = pre_draw_func;
+    command.instances = recording_->arena.copy<InstanceData>(instances);
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    DrawCommand command;
+    command.sort_key = MakeSortKey(order, shader_program.getId());
+    // Meshes live in their own buffers, they can't share a batch with anything
+    command.merge = DrawCommand::Merge::NONE;
+    command.shader_program = std::addressof(shader_program);
+    command.mesh = mesh;
+    command.params = params;
+    this->recording_->commands.push_back(command);
+  }
+
+  void CommandBuffer::draw(MeshHandle mesh, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    this->draw(mesh, shader_program, DrawParams(), order);
+    this->recording_->commands.back().pre_draw_func = pre_draw_func;
+  }
+
+  void CommandBuffer::reset() {
+    const size_t command_count = recording_->commands.size();
+    recording_->commands = std::pmr::vector<DrawCommand>(&recording_->arena);
+    recording_->arena.reset();
+    recording_->commands.reserve(command_count);
+  }
+
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "Citrus/graphics/OpenGL/CommandList.hpp"
+#include "Citrus/graphics/OpenGL/Renderer.hpp"
+
+namespace citrus::opengl {
+
+  void CommandList::checkRecording() const {
+    if (closed_) {
+      throw std::runtime_error("Attempted to record into a closed command list, reset it first");
+    }
+  }
+
+  CommandList::DrawId CommandList::draw(VertexView vertices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    this->checkRecording();
+    recorder_.draw(vertices, shader_program, params, order);
+    return static_cast<DrawId>(recorder_.size() - 1);
+  }
+
+  CommandList::DrawId CommandList::draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    this->checkRecording();
+    recorder_.draw(vertices, indices, shader_program, params, order);
+    return static_cast<DrawId>(recorder_.size() - 1);
+  }
+
+  CommandList::DrawId CommandList::draw(VertexView vertices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    this->checkRecording();
+    recorder_.draw(vertices, shader_program, pre_draw_func, order);
+    return static_cast<DrawId>(recorder_.size() - 1);
+  }
+
+  CommandList::DrawId CommandList::draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    this->checkRecording();
+    recorder_.draw(mesh, shader_program, params, order);
+    return static_cast<DrawId>(recorder_.size() - 1);
+  }
+
+  // Linked draws share a mesh and are drawn back to back, so they must share every piece of state a batch does.
+  // Only draws with equal keys are linked, nothing submitted along with the list could be sorted between them
+  static bool CanLink(const DrawCommand& previous, const DrawCommand& command) {
+    if (previous.merge == DrawCommand::Merge::NONE || command.merge != DrawCommand::Merge::ANY) {
+      return false;
+    }
+    return previous.sort_key == command.sort_key && previous.shader_program->getId() == command.shader_program->getId() &&
+           previous.indexed == command.indexed && previous.vertex_format == command.vertex_format &&
+           previous.pre_draw_func == command.pre_draw_func;
+  }
+
+  template <typename TIndex>
+  static void AppendRebasedIndices(std::span<const std::byte> indices, uint32_t base, std::vector<uint32_t>& destination) {
+    const TIndex* begin = reinterpret_cast<const TIndex*>(indices.data());
+    const TIndex* end = begin + indices.size() / sizeof(TIndex);
+    std::transform(begin, end, std::back_inserter(destination), [base](TIndex index) {
+      return static_cast<uint32_t>(index + base);
+    });
+  }
+
+  CommandList::~CommandList() {
+    // Only a stale handle makes destroying a mesh fail, and then there is nothing left to release
+    try {
+      this->releaseMeshes();
+    } catch (const std::exception&) {
+    }
+  }
+
+  void CommandList::close(Renderer& renderer) {
+    this->checkRecording();
+    const auto recorded = recorder_.getCommands();
+    // Stable, draws with equal keys keep their recording order like any other submission
+    std::vector<uint32_t> order(recorded.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [recorded](uint32_t a, uint32_t b) {
+      return recorded[a].sort_key < recorded[b].sort_key;
+    });
+
+    commands_.clear();
+    ranges_.clear();
+    ranges_.reserve(recorded.size());
+    draws_.assign(recorded.size(), DrawLocation{});
+    renderer_ = &renderer;
+    std::vector<std::byte> vertices;
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < order.size();) {
+      const DrawCommand& first = recorded[order[i]];
+      if (first.mesh.isValid()) {
+        draws_[order[i]].command = static_cast<uint32_t>(commands_.size());
+        commands_.push_back(first);
+        i++;
+        continue;
+      }
+      size_t end = i + 1;
+      while (end < order.size() && CanLink(recorded[order[end - 1]], recorded[order[end]])) {
+        end++;
+      }
+
+      // The batch's draws are laid out one after the other in its mesh, each keeping its own piece to draw
+      vertices.clear();
+      indices.clear();
+      const size_t first_range = ranges_.size();
+      for (size_t j = i; j < end; j++) {
+        const DrawCommand& command = recorded[order[j]];
+        const uint32_t first_vertex = static_cast<uint32_t>(vertices.size() / first.vertex_format->stride);
+        MeshDrawRange range;
+        range.params = command.params;
+        if (command.indexed) {
+          range.first = static_cast<uint32_t>(indices.size());
+          range.count = static_cast<uint32_t>(command.getIndexCount());
+          if (command.index_type == IndexType::UINT16) {
+            AppendRebasedIndices<uint16_t>(command.indices, first_vertex, indices);
+          } else {
+            AppendRebasedIndices<uint32_t>(command.indices, first_vertex, indices);
+          }
+        } else {
+          range.first = first_vertex;
+          range.count = static_cast<uint32_t>(command.getVertexCount());
+        }
+        vertices.insert(vertices.end(), command.vertices.begin(), command.vertices.end());
+        draws_[order[j]] = DrawLocation{static_cast<uint32_t>(commands_.size()), static_cast<uint32_t>(ranges_.size()), first_vertex,
+                                        static_cast<uint32_t>(command.getVertexCount()), command.vertex_format};
+        ranges_.push_back(range);
+      }
+
+      DrawCommand batch;
+      batch.sort_key = first.sort_key;
+      batch.merge = DrawCommand::Merge::NONE;
+      batch.shader_program = first.shader_program;
+      batch.pre_draw_func = first.pre_draw_func;
+      batch.vertex_format = first.vertex_format;
+      if (first.indexed) {
+        const size_t vertex_count = vertices.size() / first.vertex_format->stride;
+        const IndexBuffer index_buffer = vertex_count <= UINT16_MAX + 1 ? IndexBuffer(std::vector<uint16_t>(indices.begin(), indices.end()))
+                                                                         : IndexBuffer(std::span<const uint32_t>(indices));
+        batch.mesh = renderer.recordMeshCreation(*first.vertex_format, vertices, &index_buffer, MeshUsage::STATIC);
+      } else {
+        batch.mesh = renderer.recordMeshCreation(*first.vertex_format, vertices, nullptr, MeshUsage::STATIC);
+      }
+      meshes_.push_back(batch.mesh);
+      batch.mesh_ranges = std::span<const MeshDrawRange>(ranges_).subspan(first_range, end - i);
+      commands_.push_back(batch);
+      i = end;
+    }
+    // Everything the list draws now lives in the meshes
+    recorder_.reset();
+    closed_ = true;
+  }
+
+  // The list forgets its meshes first, a failed destruction doesn't leave them to be destroyed a second time
+  void CommandList::releaseMeshes() {
+    const std::vector<MeshHandle> meshes = std::exchange(meshes_, {});
+    Renderer* renderer = std::exchange(renderer_, nullptr);
+    for (MeshHandle mesh : meshes) {
+      renderer->destroyMesh(mesh);
+    }
+  }
+
+  void CommandList::reset() {
+    this->releaseMeshes();
+    recorder_.reset();
+    commands_.clear();
+    ranges_.clear();
+    draws_.clear();
+    closed_ = false;
+  }
+
+  const CommandList::DrawLocation& CommandList::getLocation(DrawId draw) const {
+    if (!closed_) {
+      throw std::runtime_error("Command lists can only be patched once closed");
+    }
+    if (draw >= draws_.size()) {
+      throw std::runtime_error("Attempted to patch a draw the command list doesn't have");
+    }
+    return draws_[draw];
+  }
+
+  void CommandList::setParams(DrawId draw, const DrawParams& params) {
+    const DrawLocation& location = this->getLocation(draw);
+    if (location.range == NO_RANGE) {
+      commands_[location.command].params = params;
+    } else {
+      ranges_[location.range].params = params;
+    }
+  }
+
+  void CommandList::writeVertices(DrawId draw, const VertexFormat& format, size_t first_vertex, std::span<const std::byte> vertices) {
+    const DrawLocation& location = this->getLocation(draw);
+    if (location.range == NO_RANGE) {
+      throw std::runtime_error("Attempted to update the vertices of a mesh draw, update the mesh itself instead");
+    }
+    if (location.vertex_format != &format) {
+      throw std::runtime_error("Attempted to update a draw with vertices of another format");
+    }
+    if (first_vertex + vertices.size() / format.stride > location.vertex_count) {
+      throw std::runtime_error("Attempted to update vertices past the end of a draw");
+    }
+    renderer_->recordMeshUpdate(commands_[location.command].mesh, format, location.first_vertex + first_vertex, vertices);
+  }
+
+}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "Citrus/graphics/OpenGL/GlStateCache.hpp"
+#include "glad/glad.h"
+
+namespace citrus::opengl {
+
+  static GLenum BufferTargetToGl(GlStateCache::BufferTarget target) {
+    switch (target) {
+      case GlStateCache::BufferTarget::ARRAY:
+        return GL_ARRAY_BUFFER;
+      case GlStateCache::BufferTarget::COPY_WRITE:
+        return GL_COPY_WRITE_BUFFER;
+      case GlStateCache::BufferTarget::DRAW_INDIRECT:
+        return GL_DRAW_INDIRECT_BUFFER;
+      case GlStateCache::BufferTarget::UNIFORM:
+        return GL_UNIFORM_BUFFER;
+      case GlStateCache::BufferTarget::COUNT:
+        break;
+    }
+    throw std::runtime_error("Invalid buffer target");
+  }
+
+  static void SetCapability(GLenum capability, bool enabled) {
+    if (enabled) {
+      glEnable(capability);
+    } else {
+      glDisable(capability);
+    }
+  }
+
+  void GlStateCache::useProgram(unsigned int program) {
+    if (this->elide(program_ == program)) {
+      return;
+    }
+    glUseProgram(program);
+    program_ = program;
+  }
+
+  void GlStateCache::bindVertexArray(unsigned int vao) {
+    if (this->elide(vertex_array_ == vao)) {
+      return;
+    }
+    glBindVertexArray(vao);
+    vertex_array_ = vao;
+  }
+
+  void GlStateCache::bindBuffer(BufferTarget target, unsigned int buffer) {
+    unsigned int& bound = buffers_[static_cast<size_t>(target)];
+    if (this->elide(bound == buffer)) {
+      return;
+    }
+    glBindBuffer(BufferTargetToGl(target), buffer);
+    bound = buffer;
+  }
+
+  void GlStateCache::bindBufferBase(BufferTarget target, unsigned int index, unsigned int buffer) {
+    // Indexed bindings aren't cached, but they also bind the generic target
+    this->elide(false);
+    glBindBufferBase(BufferTargetToGl(target), index, buffer);
+    buffers_[static_cast<size_t>(target)] = buffer;
+  }
+
+  void GlStateCache::bindTexture2D(unsigned int unit, unsigned int texture) {
+    if (unit >= TEXTURE_UNITS) {
+      throw std::runtime_error("Texture unit out of range");
+    }
+    if (this->elide(textures_[unit] == texture)) {
+      return;
+    }
+    if (active_texture_unit_ != unit) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      active_texture_unit_ = unit;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    textures_[unit] = texture;
+  }
+
+  void GlStateCache::setBlend(bool enabled) {
+    if (this->elide(blend_ == static_cast<int>(enabled))) {
+      return;
+    }
+    SetCapability(GL_BLEND, enabled);
+    blend_ = enabled;
+  }
+
+  void GlStateCache::setBlendFunc(unsigned int source_factor, unsigned int destination_factor) {
+    if (this->elide(blend_source_ == source_factor && blend_destination_ == destination_factor)) {
+      return;
+    }
+    glBlendFunc(source_factor, destination_factor);
+    blend_source_ = source_factor;
+    blend_destination_ = destination_factor;
+  }
+
+  void GlStateCache::setDepthTest(bool enabled) {
+    if (this->elide(depth_test_ == static_cast<int>(enabled))) {
+      return;
+    }
+    SetCapability(GL_DEPTH_TEST, enabled);
+    depth_test_ = enabled;
+  }
+
+  void GlStateCache::setDepthFunc(unsigned int func) {
+    if (this->elide(depth_func_ == func)) {
+      return;
+    }
+    glDepthFunc(func);
+    depth_func_ = func;
+  }
+
+  void GlStateCache::setScissorTest(bool enabled) {
+    if (this->elide(scissor_test_ == static_cast<int>(enabled))) {
+      return;
+    }
+    SetCapability(GL_SCISSOR_TEST, enabled);
+    scissor_test_ = enabled;
+  }
+
+  void GlStateCache::setScissor(Rect rect) {
+    if (this->elide(scissor_known_ && scissor_ == rect)) {
+      return;
+    }
+    glScissor(rect.x, rect.y, rect.width, rect.height);
+    scissor_ = rect;
+    scissor_known_ = true;
+  }
+
+  void GlStateCache::setViewport(Rect rect) {
+    if (this->elide(viewport_known_ && viewport_ == rect)) {
+      return;
+    }
+    glViewport(rect.x, rect.y, rect.width, rect.height);
+    viewport_ = rect;
+    viewport_known_ = true;
+  }
+
+  void GlStateCache::setClearColor(Color color) {
+    auto color_arr = color.asFloatRgba();
+    if (this->elide(clear_color_known_ && clear_color_.asFloatRgba() == color_arr)) {
+      return;
+    }
+    glClearColor(color_arr[0], color_arr[1], color_arr[2], color_arr[3]);
+    clear_color_ = color;
+    clear_color_known_ = true;
+  }
+
+  void GlStateCache::onProgramDeleted(unsigned int program) noexcept {
+    // A deleted program stays in use until another one is, only a forgotten id could be reused
+    if (program_ == program) {
+      program_ = UNKNOWN;
+    }
+  }
+
+  void GlStateCache::onVertexArrayDeleted(unsigned int vao) noexcept {
+    if (vertex_array_ == vao) {
+      vertex_array_ = 0;
+    }
+  }
+
+  void GlStateCache::onBufferDeleted(unsigned int buffer) noexcept {
+    std::replace(buffers_.begin(), buffers_.end(), buffer, 0u);
+  }
+
+  void GlStateCache::onTextureDeleted(unsigned int texture) noexcept {
+    std::replace(textures_.begin(), textures_.end(), texture, 0u);
+  }
+
+  void GlStateCache::invalidate() noexcept {
+    program_ = UNKNOWN;
+    vertex_array_ = UNKNOWN;
+    buffers_.fill(UNKNOWN);
+    active_texture_unit_ = UNKNOWN;
+    textures_.fill(UNKNOWN);
+    blend_ = depth_test_ = scissor_test_ = -1;
+    blend_source_ = blend_destination_ = UNKNOWN;
+    depth_func_ = UNKNOWN;
+    scissor_known_ = viewport_known_ = clear_color_known_ = false;
+  }
+
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "Citrus/graphics/OpenGL/GpuProfiler.hpp"
+#include "glad/glad.h"
+
+namespace citrus::opengl {
+
+  GpuProfiler::~GpuProfiler() {
+    for (FrameQueries& frame : frames_) {
+      if (!frame.queries.empty()) {
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+      }
+    }
+  }
+
+  void GpuProfiler::beginFrame() {
+    // Collects every finished frame oldest first, stopping at the first one the GPU hasn't reached yet
+    for (size_t i = 1; i <= FRAME_LATENCY; i++) {
+      FrameQueries& frame = frames_[(current_ + i) % FRAME_LATENCY];
+      if (frame.pending && !this->collect(frame)) {
+        break;
+      }
+    }
+    FrameQueries& frame = frames_[current_];
+    if (frame.pending) {
+      // Waiting for the results would stall the pipeline, the frame is dropped instead
+      frame.pending = false;
+      dropped_frames_++;
+    }
+    frame.frame = ++frame_count_;
+    frame.query_count = 0;
+    frame.draws.clear();
+    this->timestamp(frame);
+  }
+
+  void GpuProfiler::endDraw(unsigned int shader_program, size_t batch_count, size_t command_count) {
+    FrameQueries& frame = frames_[current_];
+    frame.draws.push_back(DrawTiming{shader_program, batch_count, command_count, 0.0});
+    this->timestamp(frame);
+  }
+
+  void GpuProfiler::endFrame() {
+    frames_[current_].pending = true;
+    current_ = (current_ + 1) % FRAME_LATENCY;
+  }
+
+  GpuProfiler::FrameReport GpuProfiler::getLatestReport() const {
+    std::lock_guard lock(report_mutex_);
+    return report_;
+  }
+
+  void GpuProfiler::timestamp(FrameQueries& frame) {
+    if (frame.query_count == frame.queries.size()) {
+      const size_t grow = std::max<size_t>(frame.queries.size(), 16);
+      frame.queries.resize(frame.queries.size() + grow);
+      glGenQueries(grow, frame.queries.data() + frame.query_count);
+    }
+    glQueryCounter(frame.queries[frame.query_count++], GL_TIMESTAMP);
+  }
+
+  bool GpuProfiler::collect(FrameQueries& frame) {
+    // Queries complete in order, the last one being available means every other one is
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(frame.queries[frame.query_count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return false;
+    }
+    results_.resize(frame.query_count);
+    for (size_t i = 0; i < frame.query_count; i++) {
+      glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &results_[i]);
+    }
+    frame.pending = false;
+
+    constexpr double NANOSECONDS_PER_MILLISECOND = 1e6;
+    std::lock_guard lock(report_mutex_);
+    report_.frame = frame.frame;
+    report_.milliseconds = (results_.back() - results_.front()) / NANOSECONDS_PER_MILLISECOND;
+    report_.draws = frame.draws;
+    report_.shaders.clear();
+    for (size_t i = 0; i < report_.draws.size(); i++) {
+      DrawTiming& draw = report_.draws[i];
+      draw.milliseconds = (results_[i + 1] - results_[i]) / NANOSECONDS_PER_MILLISECOND;
+      auto shader = std::find_if(report_.shaders.begin(), report_.shaders.end(), [&draw](const ShaderTiming& timing) {
+        return timing.shader_program == draw.shader_program;
+      });
+      if (shader == report_.shaders.end()) {
+        shader = report_.shaders.insert(report_.shaders.end(), ShaderTiming{draw.shader_program, 0, 0.0});
+      }
+      shader->draw_count++;
+      shader->milliseconds += draw.milliseconds;
+    }
+    std::sort(report_.shaders.begin(), report_.shaders.end(), [](const ShaderTiming& a, const ShaderTiming& b) {
+      return a.milliseconds > b.milliseconds;
+    });
+    return true;
+  }
+
+}
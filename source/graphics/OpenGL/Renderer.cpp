@@ -1,32 +1,67 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <optional>
 #include <span>
 #include <stdexcept>
 #include <stddef.h>
+#include <type_traits>
 #include <utility>
 
 #include "Citrus/graphics/OpenGL/Renderer.hpp"
+#include "Citrus/sys/Profiler.hpp"
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
 constexpr auto generic_vertex_shader_source =
     "#version 330 core\n"
     "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 8) in vec3 aDrawOffset;\n"
+    "layout (location = 9) in vec3 aDrawScale;\n"
+    "layout (location = 10) in vec4 aDrawColor;\n"
+    "out vec4 vDrawColor;\n"
     "void main()"
     "{"
-    "gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);\n"
+    "gl_Position = vec4(vec3(aPos.x, aPos.y, 0.0) * aDrawScale + aDrawOffset, 1.0);\n"
+    "vDrawColor = aDrawColor;\n"
     "}";
 constexpr auto generic_fragment_shader_source =
     "#version 330 core\n"
     "uniform vec4 in_color;\n"
+    "in vec4 vDrawColor;\n"
     "out vec4 FragColor;\n"
     "void main()"
     "{"
-    "FragColor = in_color;\n"
+    "FragColor = in_color * vDrawColor;\n"
+    "}";
+constexpr auto generic_instanced_vertex_shader_source =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 1) in vec4 aColor;\n"
+    "layout (location = 8) in vec3 aInstanceOffset;\n"
+    "layout (location = 9) in vec3 aInstanceScale;\n"
+    "layout (location = 10) in vec4 aInstanceColor;\n"
+    "out vec4 vColor;\n"
+    "void main()"
+    "{"
+    "gl_Position = vec4(aPos * aInstanceScale + aInstanceOffset, 1.0);\n"
+    "vColor = aColor * aInstanceColor;\n"
+    "}";
+constexpr auto generic_instanced_fragment_shader_source =
+    "#version 330 core\n"
+    "in vec4 vColor;\n"
+    "out vec4 FragColor;\n"
+    "void main()"
+    "{"
+    "FragColor = vColor;\n"
     "}";
 
 
 namespace citrus::opengl {
 
-  Renderer::Renderer(const Window& window) {
+  Renderer::Renderer(const Window& window, std::optional<std::filesystem::path> shader_cache_directory) {
     window_ = &window;
     glfwMakeContextCurrent(window.getGlfwPtr());
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
@@ -34,99 +69,1000 @@ namespace citrus::opengl {
           "Failed to initialize OpenGL functions, your device may not be "
           "compatible with OpenGL");
     }
-    glViewport(0, 0, window.getSize().x, window.getSize().y);
+    GlStateCache::MakeCurrent(&state_cache_);
+    state_cache_.setViewport({0, 0, window.getSize().x, window.getSize().y});
 
+    if (shader_cache_directory) {
+      shader_cache_.emplace(*shader_cache_directory);
+    }
     {
-      auto generic_vertex_shader =
-          Shader(std::string_view(generic_vertex_shader_source),
-               Shader::ShaderType::VERTEX);
-      auto generic_fragment_shader =
-          Shader(std::string_view(generic_fragment_shader_source),
-               Shader::ShaderType::FRAGMENT);
-      generic_shader_program_ =
-          ShaderProgram(generic_vertex_shader, generic_fragment_shader);
-    }
-
-    glGenVertexArrays(1, &vao_);
-    glGenBuffers(1, &vbo_);
-    glGenBuffers(1, &ebo_);
-
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-
-    // position attribute
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-  }
-  // TODO: Make DrawBatch hold an array of different Pre-Draw functions
-  void Renderer::draw(const VertexBuffer& vertices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func) {
-    if (this->draw_batch_queue_.empty() || this->draw_batch_queue_.back().shader_program->getId() != shader_program.getId()) {
-      DrawBatch new_batch;
-      new_batch.vertex_buffers.emplace_back(vertices.getVertices());
-      new_batch.shader_program = std::addressof(shader_program);
-      new_batch.pre_draw_func = pre_draw_func;
-      this->draw_batch_queue_.push(std::move(new_batch));
+      generic_shader_program_ = this->loadShaderProgram(generic_vertex_shader_source, generic_fragment_shader_source);
+      // in_color tints the per draw color, start at white so draws using DrawParams don't need a pre-draw function
+      this->useShaderProgram(generic_shader_program_);
+      generic_shader_program_.setUniformVal("in_color"_uid, Color(1.f, 1.f, 1.f, 1.f));
+    }
+    generic_instanced_shader_program_ = this->loadShaderProgram(generic_instanced_vertex_shader_source, generic_instanced_fragment_shader_source);
+
+    vertex_stream_ = StreamBuffer(VERTEX_STREAM_REGION_SIZE);
+    index_stream_ = StreamBuffer(INDEX_STREAM_REGION_SIZE);
+    instance_stream_ = StreamBuffer(INSTANCE_STREAM_REGION_SIZE);
+    // Multi draw indirect is core since 4.3, the 3.3 fallback keeps issuing one draw per batch
+    multi_draw_indirect_ = GLAD_GL_VERSION_4_3;
+    if (multi_draw_indirect_) {
+      indirect_stream_ = StreamBuffer(INDIRECT_STREAM_REGION_SIZE);
+    }
+
+    this->getStreamVertexArrays(&VertexFormatOf<Vertex>::value);
+  }
+
+  static GLenum GlAttribType(VertexAttribType type) {
+    switch (type) {
+      case VertexAttribType::FLOAT: return GL_FLOAT;
+      case VertexAttribType::HALF_FLOAT: return GL_HALF_FLOAT;
+      case VertexAttribType::INT8: return GL_BYTE;
+      case VertexAttribType::UINT8: return GL_UNSIGNED_BYTE;
+      case VertexAttribType::INT16: return GL_SHORT;
+      case VertexAttribType::UINT16: return GL_UNSIGNED_SHORT;
+      case VertexAttribType::INT32: return GL_INT;
+      case VertexAttribType::UINT32: return GL_UNSIGNED_INT;
+      case VertexAttribType::INT_2_10_10_10: return GL_INT_2_10_10_10_REV;
+    }
+    return GL_FLOAT;
+  }
+  // Points the attributes of the bound vao at the bound array buffer
+  static void SetVertexAttributes(const VertexFormat& format) {
+    for (const VertexAttribute& attribute : format.getAttributes()) {
+      const GLenum type = GlAttribType(attribute.type);
+      const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(attribute.offset));
+      if (attribute.mode == VertexAttribMode::INTEGER) {
+        glVertexAttribIPointer(attribute.location, attribute.components, type, format.stride, offset);
+      } else {
+        const GLboolean normalized = attribute.mode == VertexAttribMode::NORMALIZED ? GL_TRUE : GL_FALSE;
+        glVertexAttribPointer(attribute.location, attribute.components, type, normalized, format.stride, offset);
+      }
+      glEnableVertexAttribArray(attribute.location);
+    }
+  }
+
+  const Renderer::StreamVertexArrays& Renderer::getStreamVertexArrays(const VertexFormat* format) {
+    auto arrays = std::find_if(stream_vertex_arrays_.begin(), stream_vertex_arrays_.end(), [format](const StreamVertexArrays& arrays) {
+      return arrays.format == format;
+    });
+    if (arrays == stream_vertex_arrays_.end()) {
+      StreamVertexArrays created;
+      created.format = format;
+      glGenVertexArrays(1, &created.vao);
+      glGenVertexArrays(1, &created.instanced_vao);
+      arrays = stream_vertex_arrays_.insert(stream_vertex_arrays_.end(), created);
+    }
+    if (arrays->vertex_generation != vertex_stream_.getGeneration() || arrays->index_generation != index_stream_.getGeneration()) {
+      this->bindStreams(*arrays);
+    }
+    return *arrays;
+  }
+  // Points the vaos at the stream buffers, a stream may recreate its buffer when it grows
+  void Renderer::bindStreams(StreamVertexArrays& arrays) {
+    for (unsigned int vao : {arrays.vao, arrays.instanced_vao}) {
+      state_cache_.bindVertexArray(vao);
+      // The element buffer binding is vertex array state, it doesn't go through the cache
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_stream_.getId());
+      state_cache_.bindBuffer(GlStateCache::BufferTarget::ARRAY, vertex_stream_.getId());
+      SetVertexAttributes(*arrays.format);
+    }
+    // instance attributes, the pointers are set per draw by bindInstanceStream
+    for (unsigned int location = 8; location <= 11; location++) {
+      glEnableVertexAttribArray(location);
+      glVertexAttribDivisor(location, 1);
+    }
+    arrays.vertex_generation = vertex_stream_.getGeneration();
+    arrays.index_generation = index_stream_.getGeneration();
+  }
+  // Points the instance attributes of the bound instanced vao at an offset of the instance stream
+  void Renderer::bindInstanceStream(size_t offset) {
+    state_cache_.bindBuffer(GlStateCache::BufferTarget::ARRAY, instance_stream_.getId());
+    glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, offset)));
+    glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, scale)));
+    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, color)));
+    glVertexAttribIPointer(11, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, material_id)));
+  }
+  // Sets the per draw attributes as constant values, used when the instance attribute arrays are disabled
+  void Renderer::setDrawParams(const DrawParams& params) {
+    glVertexAttrib3f(8, params.offset.x, params.offset.y, params.offset.z);
+    glVertexAttrib3f(9, params.scale.x, params.scale.y, params.scale.z);
+    auto color_arr = params.color.asFloatRgba();
+    glVertexAttrib4f(10, color_arr[0], color_arr[1], color_arr[2], color_arr[3]);
+    glVertexAttribI4ui(11, params.material_id, 0, 0, 1);
+  }
+  void Renderer::draw(VertexView vertices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->recordingPacket().command_buffer.draw(vertices, shader_program, pre_draw_func, order);
+  }
+  void Renderer::draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->recordingPacket().command_buffer.draw(vertices, indices, shader_program, pre_draw_func, order);
+  }
+  void Renderer::draw(VertexView vertices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->recordingPacket().command_buffer.draw(vertices, shader_program, params, order);
+  }
+  void Renderer::draw(VertexView vertices, const IndexBuffer& indices, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->recordingPacket().command_buffer.draw(vertices, indices, shader_program, params, order);
+  }
+  void Renderer::draw(DrawBatch&& batch, PreDrawFunc pre_draw_func, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->recordingPacket().command_buffer.draw(std::move(batch), pre_draw_func, order);
+  }
+  void Renderer::drawInstanced(VertexView vertices, std::span<const InstanceData> instances, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::drawInstanced");
+    this->recordingPacket().command_buffer.drawInstanced(vertices, instances, shader_program, pre_draw_func, order);
+  }
+
+  // Moves the draws recorded through Renderer::draw since the last call into the queue, keeping them in submission order
+  void Renderer::queueImmediateCommands(FramePacket& packet) {
+    const auto commands = packet.command_buffer.getCommands().subspan(packet.immediate_commands_queued);
+    packet.draw_command_queue.insert(packet.draw_command_queue.end(), commands.begin(), commands.end());
+    packet.immediate_commands_queued = packet.command_buffer.size();
+  }
+
+  void Renderer::submit(std::span<const CommandBuffer> command_buffers) {
+    CITRUS_PROFILE_SCOPE("Renderer::submit");
+    FramePacket& packet = this->recordingPacket();
+    this->queueImmediateCommands(packet);
+    for (const CommandBuffer& command_buffer : command_buffers) {
+      const auto commands = command_buffer.getCommands();
+      packet.draw_command_queue.insert(packet.draw_command_queue.end(), commands.begin(), commands.end());
+    }
+  }
+
+  void Renderer::submit(const CommandList& command_list) {
+    CITRUS_PROFILE_SCOPE("Renderer::submit");
+    if (!command_list.isClosed()) {
+      throw std::runtime_error("Attempted to submit a command list that wasn't closed");
+    }
+    if (command_list.getRenderer() != this) {
+      throw std::runtime_error("Attempted to submit a command list closed for another renderer");
+    }
+    FramePacket& packet = this->recordingPacket();
+    this->queueImmediateCommands(packet);
+    // The ranges are copied with the frame, patching the list afterwards doesn't touch frames already queued
+    for (DrawCommand command : command_list.getCommands()) {
+      command.mesh_ranges = packet.arena.copy<MeshDrawRange>(command.mesh_ranges);
+      packet.draw_command_queue.push_back(command);
+    }
+  }
+
+  // Stable LSD radix sort over the 64 bit keys, one pass per byte, skipping bytes every key shares
+  static void RadixSortKeys(std::vector<std::pair<uint64_t, uint32_t>>& entries, std::vector<std::pair<uint64_t, uint32_t>>& scratch) {
+    scratch.resize(entries.size());
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+      size_t counts[256] = {};
+      for (const auto& entry : entries) {
+        counts[(entry.first >> shift) & 0xFF]++;
+      }
+      if (counts[(entries.front().first >> shift) & 0xFF] == entries.size()) {
+        continue;
+      }
+      size_t offset = 0;
+      for (size_t& count : counts) {
+        offset += std::exchange(count, offset);
+      }
+      for (const auto& entry : entries) {
+        scratch[counts[(entry.first >> shift) & 0xFF]++] = entry;
+      }
+      entries.swap(scratch);
+    }
+  }
+
+  // Sorts the queued commands and merges neighbours sharing state into batches
+  void Renderer::buildBatches(std::span<const DrawCommand> commands) {
+    sorted_commands_.clear();
+    for (uint32_t i = 0; i < commands.size(); i++) {
+      sorted_commands_.emplace_back(commands[i].sort_key, i);
+    }
+    RadixSortKeys(sorted_commands_, sort_scratch_);
+    sorted_command_queue_.clear();
+    for (const auto& [sort_key, command_index] : sorted_commands_) {
+      sorted_command_queue_.push_back(commands[command_index]);
+    }
+
+    batch_ranges_.clear();
+    for (size_t i = 0; i < sorted_command_queue_.size(); i++) {
+      const DrawCommand& command = sorted_command_queue_[i];
+      if (!batch_ranges_.empty()) {
+        BatchRange& batch = batch_ranges_.back();
+        const DrawCommand& first = sorted_command_queue_[batch.first_command];
+        // Differing uniforms go through the draw parameters, only a different pre-draw function forces a new batch
+        const bool compatible = first.shader_program->getId() == command.shader_program->getId() && first.indexed == command.indexed &&
+                                first.vertex_format == command.vertex_format && first.pre_draw_func == command.pre_draw_func;
+        if (command.merge == DrawCommand::Merge::PREVIOUS || (command.merge == DrawCommand::Merge::ANY && batch.mergeable && compatible)) {
+          batch.command_count++;
+          continue;
+        }
+      }
+      BatchRange batch;
+      batch.first_command = i;
+      batch.command_count = 1;
+      batch.mergeable = command.merge == DrawCommand::Merge::ANY;
+      batch_ranges_.push_back(batch);
+    }
+  }
+
+  std::span<const DrawCommand> Renderer::batchCommands(const BatchRange& batch) const {
+    return std::span<const DrawCommand>(sorted_command_queue_).subspan(batch.first_command, batch.command_count);
+  }
+
+  template <typename TIndex, typename TSource>
+  static TIndex* CopyRebasedIndices(std::span<const std::byte> source, size_t base, TIndex* destination) {
+    const TSource* begin = reinterpret_cast<const TSource*>(source.data());
+    const TSource* end = begin + source.size() / sizeof(TSource);
+    return std::transform(begin, end, destination, [base](TSource index) {
+      return static_cast<TIndex>(index + base);
+    });
+  }
+
+  template <typename TIndex>
+  static void CopyBatchIndices(std::span<const DrawCommand> commands, std::byte* destination) {
+    TIndex* indices = reinterpret_cast<TIndex*>(destination);
+    size_t base = 0;
+    for (const DrawCommand& command : commands) {
+      // Concatenated buffers index into the batch, so every buffer is rebased past the vertices before it
+      if (command.index_type == IndexType::UINT16) {
+        indices = CopyRebasedIndices<TIndex, uint16_t>(command.indices, base, indices);
+      } else {
+        indices = CopyRebasedIndices<TIndex, uint32_t>(command.indices, base, indices);
+      }
+      base += command.getVertexCount();
+    }
+  }
+
+  static size_t IndexSize(IndexType type) {
+    return type == IndexType::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+  }
+
+  static bool HasUniformDrawParams(std::span<const DrawCommand> commands) {
+    return std::adjacent_find(commands.begin(), commands.end(), [](const DrawCommand& a, const DrawCommand& b) {
+      return std::memcmp(&a.params, &b.params, sizeof(DrawParams)) != 0;
+    }) == commands.end();
+  }
+
+  // Gathers every batch into a single region of each stream so the whole frame is uploaded at once
+  void Renderer::uploadBatches() {
+    size_t frame_vertex_bytes = 0;
+    size_t frame_index_bytes = 0;
+    size_t frame_instance_count = 0;
+    for (BatchRange& batch : batch_ranges_) {
+      const auto commands = this->batchCommands(batch);
+      batch.instanced = !commands.front().instances.empty();
+      batch.indexed = commands.front().indexed;
+      batch.vertex_format = commands.front().vertex_format;
+      for (const DrawCommand& command : commands) {
+        batch.vertex_count += command.getVertexCount();
+        batch.index_count += command.getIndexCount();
+      }
+      // Indices are rebased within the batch, 16 bits are enough as long as the batch doesn't address more vertices
+      batch.index_type = batch.vertex_count <= UINT16_MAX + 1 ? IndexType::UINT16 : IndexType::UINT32;
+      const size_t index_size = IndexSize(batch.index_type);
+      batch.index_offset = (frame_index_bytes + index_size - 1) / index_size * index_size;
+      frame_index_bytes = batch.index_offset + batch.index_count * index_size;
+      // Instanced batches stream their instances, the others one set of draw parameters per command
+      batch.instance_offset = frame_instance_count * sizeof(InstanceData);
+      batch.instance_count = batch.instanced ? commands.front().instances.size() : commands.size();
+      batch.uniform_params = HasUniformDrawParams(commands);
+      // Room for the batch and the padding aligning it to its stride
+      frame_vertex_bytes += (batch.vertex_count + 1) * batch.vertex_format->stride;
+      frame_instance_count += batch.instance_count;
+    }
+
+    // Every batch starts at a multiple of its own stride so its offset can be used as the first vertex
+    auto vertex_allocation = vertex_stream_.allocate(frame_vertex_bytes, sizeof(float));
+    size_t vertex_offset = vertex_allocation.offset;
+    for (BatchRange& batch : batch_ranges_) {
+      const size_t stride = batch.vertex_format->stride;
+      vertex_offset = (vertex_offset + stride - 1) / stride * stride;
+      batch.first_vertex = vertex_offset / stride;
+      std::byte* vertices = vertex_allocation.data + (vertex_offset - vertex_allocation.offset);
+      for (const DrawCommand& command : this->batchCommands(batch)) {
+        vertices = std::copy(command.vertices.begin(), command.vertices.end(), vertices);
+      }
+      vertex_offset += batch.vertex_count * stride;
+    }
+    vertex_stream_.flush();
+
+    size_t index_base = 0;
+    if (frame_index_bytes > 0) {
+      auto index_allocation = index_stream_.allocate(frame_index_bytes, sizeof(uint32_t));
+      for (const BatchRange& batch : batch_ranges_) {
+        if (batch.index_type == IndexType::UINT16) {
+          CopyBatchIndices<uint16_t>(this->batchCommands(batch), index_allocation.data + batch.index_offset);
+        } else {
+          CopyBatchIndices<uint32_t>(this->batchCommands(batch), index_allocation.data + batch.index_offset);
+        }
+      }
+      index_stream_.flush();
+      index_base = index_allocation.offset;
+    }
+
+    auto instance_allocation = instance_stream_.allocate(frame_instance_count * sizeof(InstanceData), sizeof(InstanceData));
+    InstanceData* instances = reinterpret_cast<InstanceData*>(instance_allocation.data);
+    for (const BatchRange& batch : batch_ranges_) {
+      for (const DrawCommand& command : this->batchCommands(batch)) {
+        if (batch.instanced) {
+          instances = std::copy(command.instances.begin(), command.instances.end(), instances);
+        } else {
+          *instances++ = command.params;
+        }
+      }
+    }
+    instance_stream_.flush();
+
+    for (BatchRange& batch : batch_ranges_) {
+      batch.index_offset += index_base;
+      batch.instance_offset += instance_allocation.offset;
+    }
+  }
+
+  struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+  };
+  struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
+
+  // Batches can share a multi draw call when they use the same program and vertex/index format and don't need different uniforms
+  bool Renderer::canShareIndirectDraw(size_t first_batch, size_t batch_index) const {
+    const BatchRange& first_range = batch_ranges_[first_batch];
+    const BatchRange& range = batch_ranges_[batch_index];
+    const DrawCommand& first = sorted_command_queue_[first_range.first_command];
+    const DrawCommand& batch = sorted_command_queue_[range.first_command];
+    if (first_range.instanced || range.instanced || first.mesh.isValid() || batch.mesh.isValid()) {
+      return false;
+    }
+    if (first.shader_program->getId() != batch.shader_program->getId() || first_range.vertex_format != range.vertex_format) {
+      return false;
+    }
+    if (first_range.indexed != range.indexed || first_range.index_type != range.index_type) {
+      return false;
+    }
+    return batch.pre_draw_func == nullptr || batch.pre_draw_func == first.pre_draw_func;
+  }
+
+  void Renderer::encodeDrawRuns() {
+    draw_runs_.clear();
+    for (size_t i = 0; i < batch_ranges_.size(); i++) {
+      if (multi_draw_indirect_ && !draw_runs_.empty()) {
+        DrawRun& run = draw_runs_.back();
+        if (this->canShareIndirectDraw(run.first_batch, i)) {
+          run.batch_count++;
+          continue;
+        }
+      }
+      draw_runs_.push_back(DrawRun{i, 1, 0, 0});
+    }
+    if (!multi_draw_indirect_) {
+      return;
+    }
+
+    // Every draw of a run gets its own command, the base instance selects its parameters
+    size_t indirect_bytes = 0;
+    for (DrawRun& run : draw_runs_) {
+      const BatchRange& first = batch_ranges_[run.first_batch];
+      if (first.instanced || (run.batch_count == 1 && first.uniform_params)) {
+        continue;
+      }
+      for (size_t i = run.first_batch; i < run.first_batch + run.batch_count; i++) {
+        run.command_count += batch_ranges_[i].command_count;
+      }
+      run.indirect_offset = indirect_bytes;
+      indirect_bytes += run.command_count * (first.indexed ? sizeof(DrawElementsIndirectCommand) : sizeof(DrawArraysIndirectCommand));
+    }
+    if (indirect_bytes == 0) {
       return;
     }
-    this->draw_batch_queue_.back().vertex_buffers.emplace_back(vertices.getVertices());
+
+    auto allocation = indirect_stream_.allocate(indirect_bytes, sizeof(GLuint));
+    for (DrawRun& run : draw_runs_) {
+      if (run.command_count == 0) {
+        continue;
+      }
+      std::byte* commands = allocation.data + run.indirect_offset;
+      for (size_t i = run.first_batch; i < run.first_batch + run.batch_count; i++) {
+        const BatchRange& batch = batch_ranges_[i];
+        size_t first_vertex = batch.first_vertex;
+        size_t first_index = batch.index_offset / IndexSize(batch.index_type);
+        GLuint base_instance = batch.instance_offset / sizeof(InstanceData);
+        for (const DrawCommand& draw_command : this->batchCommands(batch)) {
+          const GLuint vertex_count = draw_command.getVertexCount();
+          if (!batch.indexed) {
+            DrawArraysIndirectCommand command{vertex_count, 1, static_cast<GLuint>(first_vertex), base_instance};
+            std::memcpy(commands, &command, sizeof(command));
+            commands += sizeof(command);
+          } else {
+            const GLuint index_count = draw_command.getIndexCount();
+            DrawElementsIndirectCommand command{index_count, 1, static_cast<GLuint>(first_index), static_cast<GLint>(batch.first_vertex), base_instance};
+            std::memcpy(commands, &command, sizeof(command));
+            commands += sizeof(command);
+            first_index += index_count;
+          }
+          first_vertex += vertex_count;
+          base_instance++;
+        }
+      }
+      run.indirect_offset += allocation.offset;
+    }
+    indirect_stream_.flush();
   }
 
-  void Renderer::present() { 
-    while (!this->draw_batch_queue_.empty()) {
-      DrawBatch batch = std::move(draw_batch_queue_.front());
-      draw_batch_queue_.pop();
+  // Issues a single batch, expects its program to be in use
+  void Renderer::drawBatch(size_t batch_index) {
+    const BatchRange& batch = batch_ranges_[batch_index];
+    const auto commands = this->batchCommands(batch);
+    if (commands.front().mesh.isValid()) {
+      this->drawMesh(commands.front());
+      return;
+    }
+    const StreamVertexArrays& arrays = this->getStreamVertexArrays(batch.vertex_format);
+    if (batch.instanced) {
+      state_cache_.bindVertexArray(arrays.instanced_vao);
+      this->bindInstanceStream(batch.instance_offset);
+      glDrawArraysInstanced(GL_TRIANGLES, batch.first_vertex, batch.vertex_count, batch.instance_count);
+      return;
+    }
+    state_cache_.bindVertexArray(arrays.vao);
+    const GLenum index_type = batch.index_type == IndexType::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (batch.uniform_params) {
+      this->setDrawParams(commands.front().params);
+      if (batch.indexed) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, batch.index_count, index_type, (void*)batch.index_offset, batch.first_vertex);
+      } else {
+        glDrawArrays(GL_TRIANGLES, batch.first_vertex, batch.vertex_count);
+      }
+      return;
+    }
+    // Without multi draw indirect every draw is issued on its own, still without switching programs
+    size_t first_vertex = batch.first_vertex;
+    size_t index_offset = batch.index_offset;
+    for (const DrawCommand& command : commands) {
+      this->setDrawParams(command.params);
+      if (batch.indexed) {
+        const size_t index_count = command.getIndexCount();
+        glDrawElementsBaseVertex(GL_TRIANGLES, index_count, index_type, (void*)index_offset, batch.first_vertex);
+        index_offset += index_count * IndexSize(batch.index_type);
+      } else {
+        glDrawArrays(GL_TRIANGLES, first_vertex, command.getVertexCount());
+      }
+      first_vertex += command.getVertexCount();
+    }
+  }
+
+  MeshHandle Renderer::allocateMesh(const VertexFormat& format, size_t vertex_count) {
+    uint32_t index;
+    if (!free_mesh_slots_.empty()) {
+      index = free_mesh_slots_.back();
+      free_mesh_slots_.pop_back();
+    } else {
+      index = mesh_slots_.size();
+      mesh_slots_.emplace_back();
+    }
+    MeshSlot& slot = mesh_slots_[index];
+    slot.generation++;
+    slot.alive = true;
+    slot.vertex_format = &format;
+    slot.vertex_count = vertex_count;
+    return MeshHandle{index, slot.generation};
+  }
+
+  Renderer::MeshSlot& Renderer::getMeshSlot(MeshHandle mesh) {
+    if (mesh.index >= mesh_slots_.size() || !mesh_slots_[mesh.index].alive || mesh_slots_[mesh.index].generation != mesh.generation) {
+      throw std::runtime_error("Attempted to use a mesh that doesn't exist");
+    }
+    return mesh_slots_[mesh.index];
+  }
+
+  MeshHandle Renderer::recordMeshCreation(const VertexFormat& format, std::span<const std::byte> vertices, const IndexBuffer* indices, MeshUsage usage) {
+    FramePacket& packet = this->recordingPacket();
+    MeshOp op;
+    op.type = MeshOp::Type::CREATE;
+    op.mesh = this->allocateMesh(format, vertices.size() / format.stride);
+    op.usage = usage;
+    op.vertex_format = &format;
+    op.vertices = packet.arena.copy<std::byte>(vertices);
+    if (indices) {
+      op.index_type = indices->getType();
+      if (indices->getType() == IndexType::UINT16) {
+        op.indices = std::as_bytes(packet.arena.copy<uint16_t>(indices->getIndices16()));
+      } else {
+        op.indices = std::as_bytes(packet.arena.copy<uint32_t>(indices->getIndices32()));
+      }
+    }
+    packet.mesh_ops.push_back(op);
+    return op.mesh;
+  }
+
+  MeshHandle Renderer::createMesh(VertexView vertices, MeshUsage usage) {
+    return this->recordMeshCreation(VertexFormatOf<Vertex>::value, std::as_bytes(vertices.getVertices()), nullptr, usage);
+  }
+
+  MeshHandle Renderer::createMesh(VertexView vertices, const IndexBuffer& indices, MeshUsage usage) {
+    return this->recordMeshCreation(VertexFormatOf<Vertex>::value, std::as_bytes(vertices.getVertices()), &indices, usage);
+  }
+
+  void Renderer::recordMeshUpdate(MeshHandle mesh, const VertexFormat& format, size_t first_vertex, std::span<const std::byte> vertices) {
+    const MeshSlot& slot = this->getMeshSlot(mesh);
+    if (slot.vertex_format != &format) {
+      throw std::runtime_error("Attempted to update a mesh with vertices of another format");
+    }
+    if (first_vertex + vertices.size() / format.stride > slot.vertex_count) {
+      throw std::runtime_error("Attempted to update vertices past the end of a mesh");
+    }
+    FramePacket& packet = this->recordingPacket();
+    MeshOp op;
+    op.type = MeshOp::Type::UPDATE;
+    op.mesh = mesh;
+    op.first_vertex = first_vertex;
+    op.vertex_format = &format;
+    op.vertices = packet.arena.copy<std::byte>(vertices);
+    packet.mesh_ops.push_back(op);
+  }
+
+  void Renderer::updateMesh(MeshHandle mesh, size_t first_vertex, std::span<const Vertex> vertices) {
+    this->recordMeshUpdate(mesh, VertexFormatOf<Vertex>::value, first_vertex, std::as_bytes(vertices));
+  }
+
+  void Renderer::recordUniformUpload(UniformBuffer& buffer, size_t offset, std::span<const std::byte> bytes) {
+    FramePacket& packet = this->recordingPacket();
+    UniformOp op;
+    op.type = UniformOp::Type::UPLOAD;
+    op.buffer = &buffer;
+    op.offset = offset;
+    op.bytes = packet.arena.copy<std::byte>(bytes);
+    packet.uniform_ops.push_back(op);
+  }
+
+  void Renderer::recordUniformBind(UniformBuffer& buffer, unsigned int binding_point) {
+    UniformOp op;
+    op.type = UniformOp::Type::BIND;
+    op.buffer = &buffer;
+    op.binding_point = binding_point;
+    this->recordingPacket().uniform_ops.push_back(op);
+  }
+
+  void Renderer::applyUniformOps(const FramePacket& packet) {
+    for (const UniformOp& op : packet.uniform_ops) {
+      if (op.type == UniformOp::Type::UPLOAD) {
+        op.buffer->upload(op.offset, op.bytes.size(), op.bytes.data());
+      } else {
+        op.buffer->bind(op.binding_point);
+      }
+    }
+  }
 
-      this->useShaderProgram(*batch.shader_program);
+  void Renderer::destroyMesh(MeshHandle mesh) {
+    MeshSlot& slot = this->getMeshSlot(mesh);
+    slot.alive = false;
+    released_mesh_slots_.push_back(mesh.index);
+    MeshOp op;
+    op.type = MeshOp::Type::DESTROY;
+    op.mesh = mesh;
+    this->recordingPacket().mesh_ops.push_back(op);
+  }
 
-      std::vector<Vertex> vertices;
-      vertices.reserve(this->allocated_vertex_count_);
+  void Renderer::draw(MeshHandle mesh, ShaderProgram& shader_program, const DrawParams& params, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->getMeshSlot(mesh);
+    this->recordingPacket().command_buffer.draw(mesh, shader_program, params, order);
+  }
+  void Renderer::draw(MeshHandle mesh, ShaderProgram& shader_program, PreDrawFunc pre_draw_func, DrawOrder order) {
+    CITRUS_PROFILE_SCOPE("Renderer::draw");
+    this->getMeshSlot(mesh);
+    this->recordingPacket().command_buffer.draw(mesh, shader_program, pre_draw_func, order);
+  }
 
-      for (const VertexBuffer& vertex_buffer : batch.vertex_buffers) {
-        for (const Vertex& vertex : vertex_buffer.getVertices()) {
-          vertices.emplace_back(vertex);
+  // Creates and updates mesh buffers, or destroys them once the frame's draws are issued
+  void Renderer::applyMeshOps(const FramePacket& packet, bool destructions) {
+    for (const MeshOp& op : packet.mesh_ops) {
+      if ((op.type == MeshOp::Type::DESTROY) != destructions) {
+        continue;
+      }
+      if (op.mesh.index >= gpu_meshes_.size()) {
+        gpu_meshes_.resize(op.mesh.index + 1);
+      }
+      GpuMesh& mesh = gpu_meshes_[op.mesh.index];
+      switch (op.type) {
+        case MeshOp::Type::CREATE: {
+          const GLenum usage = op.usage == MeshUsage::STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+          mesh.generation = op.mesh.generation;
+          mesh.vertex_count = op.vertices.size() / op.vertex_format->stride;
+          mesh.index_count = op.indices.size() / IndexSize(op.index_type);
+          mesh.index_type = op.index_type;
+          glGenVertexArrays(1, &mesh.vao);
+          glGenBuffers(1, &mesh.vertex_buffer);
+          state_cache_.bindVertexArray(mesh.vao);
+          state_cache_.bindBuffer(GlStateCache::BufferTarget::ARRAY, mesh.vertex_buffer);
+          glBufferData(GL_ARRAY_BUFFER, op.vertices.size_bytes(), op.vertices.data(), usage);
+          SetVertexAttributes(*op.vertex_format);
+          if (!op.indices.empty()) {
+            glGenBuffers(1, &mesh.index_buffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, op.indices.size_bytes(), op.indices.data(), usage);
+          }
+          // The draw parameter attributes stay disabled and are set per draw as constant values
+          break;
+        }
+        case MeshOp::Type::UPDATE: {
+          state_cache_.bindBuffer(GlStateCache::BufferTarget::ARRAY, mesh.vertex_buffer);
+          glBufferSubData(GL_ARRAY_BUFFER, op.first_vertex * op.vertex_format->stride, op.vertices.size_bytes(), op.vertices.data());
+          break;
+        }
+        case MeshOp::Type::DESTROY: {
+          glDeleteVertexArrays(1, &mesh.vao);
+          glDeleteBuffers(1, &mesh.vertex_buffer);
+          glDeleteBuffers(1, &mesh.index_buffer);
+          state_cache_.onVertexArrayDeleted(mesh.vao);
+          state_cache_.onBufferDeleted(mesh.vertex_buffer);
+          mesh = GpuMesh();
+          break;
         }
       }
+    }
+  }
+
+  const Renderer::GpuMesh* Renderer::findGpuMesh(MeshHandle mesh) const {
+    if (mesh.index >= gpu_meshes_.size() || gpu_meshes_[mesh.index].generation != mesh.generation) {
+      return nullptr;
+    }
+    return &gpu_meshes_[mesh.index];
+  }
 
-      if (batch.pre_draw_func) {
-        batch.pre_draw_func(*batch.shader_program);
+  void Renderer::drawMesh(const DrawCommand& command) {
+    const GpuMesh* mesh = this->findGpuMesh(command.mesh);
+    if (!mesh) {
+      return;
+    }
+    state_cache_.bindVertexArray(mesh->vao);
+    const GLenum index_type = mesh->index_type == IndexType::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (command.mesh_ranges.empty()) {
+      this->setDrawParams(command.params);
+      if (mesh->index_count > 0) {
+        glDrawElements(GL_TRIANGLES, mesh->index_count, index_type, nullptr);
+      } else {
+        glDrawArrays(GL_TRIANGLES, 0, mesh->vertex_count);
       }
-      glBindVertexArray(vao_);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-      
-      if (vertices.size() > this->allocated_vertex_count_) {
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
-        this->allocated_vertex_count_ = vertices.size();
+      return;
+    }
+    // Ranges follow each other in the mesh, neighbours with the same parameters go out as a single draw
+    const auto ranges = command.mesh_ranges;
+    for (size_t i = 0; i < ranges.size();) {
+      size_t count = ranges[i].count;
+      size_t end = i + 1;
+      while (end < ranges.size() && std::memcmp(&ranges[end].params, &ranges[i].params, sizeof(DrawParams)) == 0) {
+        count += ranges[end++].count;
+      }
+      this->setDrawParams(ranges[i].params);
+      if (mesh->index_count > 0) {
+        glDrawElements(GL_TRIANGLES, count, index_type, (void*)(ranges[i].first * IndexSize(mesh->index_type)));
       } else {
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+        glDrawArrays(GL_TRIANGLES, ranges[i].first, count);
       }
-      glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-      glBindVertexArray(0);
+      i = end;
+    }
+  }
+
+  // Mixes a word at a time, every vertex of the frame goes through it so it has to keep up with copying them
+  static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    static constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+    const std::byte* bytes = static_cast<const std::byte*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i, sizeof(word));
+      hash = (hash ^ word) * MULTIPLIER;
+      hash ^= hash >> 29;
     }
+    uint64_t tail = 0;
+    if (i < size) {
+      std::memcpy(&tail, bytes + i, size - i);
+    }
+    // The size tells apart spans whose bytes would otherwise run into each other
+    hash = (hash ^ tail ^ (static_cast<uint64_t>(size) << 40)) * MULTIPLIER;
+    return hash ^ (hash >> 29);
+  }
+
+  template <typename T>
+  static uint64_t HashValue(uint64_t hash, const T& value) {
+    static_assert(std::has_unique_object_representations_v<T> || std::is_floating_point_v<T>);
+    return HashBytes(hash, &value, sizeof(T));
+  }
+
+  void Renderer::setUnchangedFrames(UnchangedFrames mode) noexcept {
+    unchanged_frames_ = mode;
+    // Frames rendered in the meantime weren't hashed, the next one can't be compared to them
+    last_frame_hash_.reset();
+  }
+
+  // Covers everything a queued frame is drawn from, empty for frames that can't be replayed
+  std::optional<uint64_t> Renderer::hashFrame(const FramePacket& packet) const {
+    CITRUS_PROFILE_SCOPE("Renderer::hashFrame");
+    // Mesh changes live on the GPU only, and pre-draw functions may set anything
+    if (!packet.mesh_ops.empty()) {
+      return std::nullopt;
+    }
+    const Vector2i size = window_->getSize();
+    uint64_t hash = HashValue(HashValue(0, size.x), size.y);
+    hash = HashValue(hash, packet.clear_color.has_value());
+    if (packet.clear_color) {
+      for (float component : packet.clear_color->asFloatRgba()) {
+        hash = HashValue(hash, component);
+      }
+    }
+    for (const UniformOp& op : packet.uniform_ops) {
+      hash = HashValue(hash, op.type);
+      hash = HashValue(hash, op.buffer->getId());
+      hash = HashValue(hash, op.offset);
+      hash = HashBytes(hash, op.bytes.data(), op.bytes.size());
+      hash = HashValue(hash, op.binding_point);
+    }
+    for (const DrawCommand& command : packet.draw_command_queue) {
+      if (command.pre_draw_func) {
+        return std::nullopt;
+      }
+      hash = HashValue(hash, command.sort_key);
+      hash = HashValue(hash, command.merge);
+      // Replays call the previous frame's program objects, the address has to match along with the GL name
+      hash = HashValue(hash, command.shader_program);
+      hash = HashValue(hash, command.shader_program->getId());
+      hash = HashValue(hash, command.vertex_format);
+      hash = HashBytes(hash, command.vertices.data(), command.vertices.size());
+      hash = HashValue(hash, command.indexed);
+      hash = HashValue(hash, command.index_type);
+      hash = HashBytes(hash, command.indices.data(), command.indices.size());
+      hash = HashBytes(hash, command.instances.data(), command.instances.size_bytes());
+      hash = HashValue(hash, command.mesh);
+      hash = HashBytes(hash, command.mesh_ranges.data(), command.mesh_ranges.size_bytes());
+      hash = HashBytes(hash, &command.params, sizeof(DrawParams));
+    }
+    return hash;
+  }
+
+  void Renderer::present() { 
+    CITRUS_PROFILE_SCOPE("Renderer::present");
+    FramePacket& packet = this->recordingPacket();
+    this->queueImmediateCommands(packet);
+    // The packet destroys these meshes, any later frame creating a mesh in their slot is submitted after it
+    free_mesh_slots_.insert(free_mesh_slots_.end(), released_mesh_slots_.begin(), released_mesh_slots_.end());
+    released_mesh_slots_.clear();
+    if (unchanged_frames_ != UnchangedFrames::RENDER) {
+      const std::optional<uint64_t> hash = this->hashFrame(packet);
+      packet.unchanged = hash && hash == last_frame_hash_;
+      last_frame_hash_ = hash;
+      if (packet.unchanged) {
+        unchanged_frame_count_++;
+        if (unchanged_frames_ == UnchangedFrames::SKIP) {
+          this->resetFramePacket(packet);
+          return;
+        }
+      }
+    }
+    if (!render_thread_.joinable()) {
+      this->renderFrame(packet);
+      this->resetFramePacket(packet);
+      return;
+    }
+    // Waits for the previous frame, which also frees the packet the next frame records into
+    std::unique_lock lock(frame_mutex_);
+    {
+      CITRUS_PROFILE_SCOPE("Renderer::waitForRenderThread");
+      frame_cv_.wait(lock, [this] { return pending_packet_ == nullptr; });
+    }
+    if (render_error_) {
+      std::rethrow_exception(std::exchange(render_error_, nullptr));
+    }
+    pending_packet_ = &packet;
+    recording_packet_ = (recording_packet_ + 1) % frame_packets_.size();
+    lock.unlock();
+    frame_cv_.notify_all();
+  }
+
+  // Submits a whole frame, this is the only place queued draws touch GL
+  void Renderer::renderFrame(FramePacket& packet) {
+    CITRUS_PROFILE_SCOPE("Renderer::renderFrame");
+    const bool gpu_profiling = gpu_profiling_;
+    if (gpu_profiling) {
+      gpu_profiler_.beginFrame();
+    }
+    if (packet.clear_color) {
+      state_cache_.setClearColor(*packet.clear_color);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
+    this->applyUniformOps(packet);
+    // An unchanged frame draws the previous frame's batches again, their vertices are still in the streams since
+    // nothing was allocated from them since. Only the commands' sizes, parameters and shaders are read, their data
+    // may already be gone
+    if (!packet.unchanged) {
+      this->applyMeshOps(packet, false);
+      if (packet.draw_command_queue.empty()) {
+        batch_ranges_.clear();
+        draw_runs_.clear();
+      } else {
+        {
+          CITRUS_PROFILE_SCOPE("Renderer::buildBatches");
+          this->buildBatches(packet.draw_command_queue);
+        }
+        {
+          CITRUS_PROFILE_SCOPE("Renderer::uploadBatches");
+          this->uploadBatches();
+          this->encodeDrawRuns();
+        }
+      }
+    }
+    if (!draw_runs_.empty()) {
+      if (multi_draw_indirect_) {
+        state_cache_.bindBuffer(GlStateCache::BufferTarget::DRAW_INDIRECT, indirect_stream_.getId());
+      }
+      for (const DrawRun& run : draw_runs_) {
+        const BatchRange& batch = batch_ranges_[run.first_batch];
+        const DrawCommand& first = sorted_command_queue_[batch.first_command];
+        this->useShaderProgram(*first.shader_program);
+        if (first.pre_draw_func) {
+          first.pre_draw_func(*first.shader_program);
+        }
+        if (run.command_count == 0) {
+          this->drawBatch(run.first_batch);
+        } else {
+          // Base instances index the whole instance stream
+          state_cache_.bindVertexArray(this->getStreamVertexArrays(batch.vertex_format).instanced_vao);
+          this->bindInstanceStream(0);
+          if (!batch.indexed) {
+            glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)run.indirect_offset, run.command_count, 0);
+          } else {
+            const GLenum index_type = batch.index_type == IndexType::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            glMultiDrawElementsIndirect(GL_TRIANGLES, index_type, (void*)run.indirect_offset, run.command_count, 0);
+          }
+        }
+        if (gpu_profiling) {
+          size_t command_count = 0;
+          for (size_t i = run.first_batch; i < run.first_batch + run.batch_count; i++) {
+            command_count += batch_ranges_[i].command_count;
+          }
+          gpu_profiler_.endDraw(first.shader_program->getId(), run.batch_count, command_count);
+        }
+      }
+    }
+    if (packet.unchanged) {
+      // The regions drawn again must not be written until this frame is done with them too
+      vertex_stream_.fenceLastFrameAgain();
+      index_stream_.fenceLastFrameAgain();
+      instance_stream_.fenceLastFrameAgain();
+      if (multi_draw_indirect_) {
+        indirect_stream_.fenceLastFrameAgain();
+      }
+    } else {
+      this->applyMeshOps(packet, true);
+      vertex_stream_.endFrame();
+      index_stream_.endFrame();
+      instance_stream_.endFrame();
+      if (multi_draw_indirect_) {
+        indirect_stream_.endFrame();
+      }
+    }
+    if (gpu_profiling) {
+      gpu_profiler_.endFrame();
+    }
+    CITRUS_PROFILE_SCOPE("glfwSwapBuffers");
     glfwSwapBuffers(window_->getGlfwPtr()); 
   }
 
+  // Releases everything the frame's queue allocated, the next frame reuses the same memory
+  void Renderer::resetFramePacket(FramePacket& packet) {
+    const size_t command_count = packet.draw_command_queue.size();
+    frame_allocation_count_ = packet.arena.getUpstreamAllocationCount() + packet.command_buffer.getAllocationCount();
+
+    packet.draw_command_queue = std::pmr::vector<DrawCommand>(&packet.arena);
+    packet.mesh_ops = std::pmr::vector<MeshOp>(&packet.arena);
+    packet.uniform_ops = std::pmr::vector<UniformOp>(&packet.arena);
+    packet.arena.reset();
+    packet.draw_command_queue.reserve(command_count);
+    packet.command_buffer.reset();
+    packet.immediate_commands_queued = 0;
+    packet.clear_color.reset();
+    packet.unchanged = false;
+  }
+
+  void Renderer::startRenderThread() {
+    if (render_thread_.joinable()) {
+      return;
+    }
+    // The context can only be current on one thread, the render thread takes it until it is stopped
+    glfwMakeContextCurrent(nullptr);
+    GlStateCache::MakeCurrent(nullptr);
+    stop_render_thread_ = false;
+    render_thread_ = std::thread([this] { this->renderThreadMain(); });
+  }
+
+  void Renderer::stopRenderThread() {
+    if (!render_thread_.joinable()) {
+      return;
+    }
+    {
+      std::unique_lock lock(frame_mutex_);
+      frame_cv_.wait(lock, [this] { return pending_packet_ == nullptr; });
+      stop_render_thread_ = true;
+    }
+    frame_cv_.notify_all();
+    render_thread_.join();
+    glfwMakeContextCurrent(window_->getGlfwPtr());
+    GlStateCache::MakeCurrent(&state_cache_);
+    if (render_error_) {
+      std::rethrow_exception(std::exchange(render_error_, nullptr));
+    }
+  }
+
+  void Renderer::renderThreadMain() {
+    glfwMakeContextCurrent(window_->getGlfwPtr());
+    GlStateCache::MakeCurrent(&state_cache_);
+    std::unique_lock lock(frame_mutex_);
+    while (true) {
+      frame_cv_.wait(lock, [this] { return pending_packet_ != nullptr || stop_render_thread_; });
+      if (!pending_packet_) {
+        break;
+      }
+      // The packet belongs to this thread until pending_packet_ is cleared
+      FramePacket& packet = *pending_packet_;
+      lock.unlock();
+      try {
+        this->renderFrame(packet);
+      } catch (...) {
+        // Reported to the main thread by its next present
+        render_error_ = std::current_exception();
+      }
+      this->resetFramePacket(packet);
+      lock.lock();
+      pending_packet_ = nullptr;
+      frame_cv_.notify_all();
+    }
+    GlStateCache::MakeCurrent(nullptr);
+    glfwMakeContextCurrent(nullptr);
+  }
+
+  ShaderProgram Renderer::loadShaderProgram(std::string_view vertex_source, std::string_view fragment_source) {
+    if (shader_cache_) {
+      return shader_cache_->load(vertex_source, fragment_source);
+    }
+    auto vertex_shader = Shader(vertex_source, Shader::ShaderType::VERTEX);
+    auto fragment_shader = Shader(fragment_source, Shader::ShaderType::FRAGMENT);
+    return ShaderProgram(vertex_shader, fragment_shader);
+  }
+
   Renderer::~Renderer() {
-    glDeleteVertexArrays(1, &vao_);
-    glDeleteBuffers(1, &vbo_);
-    glDeleteBuffers(1, &ebo_);
+    try {
+      this->stopRenderThread();
+    } catch (...) {
+      // The frame that failed is already lost, there is nobody left to report it to
+    }
+    for (const GpuMesh& mesh : gpu_meshes_) {
+      if (mesh.generation != 0) {
+        glDeleteVertexArrays(1, &mesh.vao);
+        glDeleteBuffers(1, &mesh.vertex_buffer);
+        glDeleteBuffers(1, &mesh.index_buffer);
+      }
+    }
+    for (const StreamVertexArrays& arrays : stream_vertex_arrays_) {
+      glDeleteVertexArrays(1, &arrays.vao);
+      glDeleteVertexArrays(1, &arrays.instanced_vao);
+    }
+    GlStateCache::MakeCurrent(nullptr);
   }
   void Renderer::useShaderProgram( ShaderProgram & program) {
-    if (!program.isActive()) {
-      glUseProgram(program.getId());
-      ShaderProgram::setActiveProgramId(program.getId());
-    }
+    state_cache_.useProgram(program.getId());
   }
   void Renderer::clearColor(Color color) {
-    auto color_arr = color.asFloatRgba();
-    glClearColor(color_arr[0], color_arr[1], color_arr[2], color_arr[3]);
-    glClear(GL_COLOR_BUFFER_BIT);
+    this->recordingPacket().clear_color = color;
   }
 };
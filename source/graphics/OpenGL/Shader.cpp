@@ -1,11 +1,17 @@
+#include <algorithm>
+#include <stdexcept>
+
 #include "glad/glad.h"
 #include "Citrus/graphics/OpenGL/Shader.hpp"
+#include "Citrus/sys/Profiler.hpp"
 
 namespace citrus::opengl {
   bool Shader::fromString(const std::string_view& source, ShaderType type) {
+    CITRUS_PROFILE_SCOPE("Shader::compile");
     this->shader_handle_ = glCreateShader(CitrusGlToGlShaderType(type));
     const char* src = source.data();
-    glShaderSource(this->shader_handle_, 1, &src, nullptr);
+    const GLint src_length = source.size();
+    glShaderSource(this->shader_handle_, 1, &src, &src_length);
     glCompileShader(this->shader_handle_);
     int success;
     glGetShaderiv(this->shader_handle_, GL_COMPILE_STATUS, &success);
@@ -41,8 +47,13 @@ namespace citrus::opengl {
   Shader::~Shader() {
     glDeleteShader(this->shader_handle_);
   }
-  ShaderProgram::ShaderProgram(const Shader& vertexShader, const Shader& fragmentShader) {
+  // Delegating makes the program owned before anything can throw, a failed link or reflection still deletes it
+  ShaderProgram::ShaderProgram(const Shader& vertexShader, const Shader& fragmentShader, bool binary_retrievable) : ShaderProgram() {
+    CITRUS_PROFILE_SCOPE("ShaderProgram::link");
     this->shader_program_handle_ = glCreateProgram();
+    if (binary_retrievable && GLAD_GL_VERSION_4_1) {
+      glProgramParameteri(this->shader_program_handle_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(this->shader_program_handle_, vertexShader.shader_handle_);
     glAttachShader(this->shader_program_handle_, fragmentShader.shader_handle_);
     glLinkProgram(this->shader_program_handle_);
@@ -56,9 +67,94 @@ namespace citrus::opengl {
       glGetProgramInfoLog(this->shader_program_handle_, info_log_size, nullptr, &info_log[0]);
       throw std::runtime_error(info_log);
     }
+    this->reflectUniforms();
+  }
+  std::optional<ShaderProgram> ShaderProgram::FromBinary(unsigned int format, std::span<const std::byte> binary) {
+    if (!GLAD_GL_VERSION_4_1) {
+      return std::nullopt;
+    }
+    CITRUS_PROFILE_SCOPE("ShaderProgram::loadBinary");
+    ShaderProgram program;
+    program.shader_program_handle_ = glCreateProgram();
+    glProgramBinary(program.shader_program_handle_, format, binary.data(), binary.size());
+    int success;
+    glGetProgramiv(program.shader_program_handle_, GL_LINK_STATUS, &success);
+    if (!success) {
+      return std::nullopt;
+    }
+    program.reflectUniforms();
+    return program;
+  }
+  ShaderProgram ShaderProgram::FromLinkedProgram(unsigned int program_handle) {
+    ShaderProgram program;
+    program.shader_program_handle_ = program_handle;
+    program.reflectUniforms();
+    return program;
+  }
+  std::vector<std::byte> ShaderProgram::getBinary(unsigned int& format) const {
+    std::vector<std::byte> binary;
+    if (!GLAD_GL_VERSION_4_1) {
+      return binary;
+    }
+    GLint length = 0;
+    glGetProgramiv(this->shader_program_handle_, GL_PROGRAM_BINARY_LENGTH, &length);
+    binary.resize(length);
+    GLenum binary_format = 0;
+    glGetProgramBinary(this->shader_program_handle_, length, nullptr, &binary_format, binary.data());
+    format = binary_format;
+    return binary;
+  }
+  // Builds the uniform table once so setting a uniform never asks the driver for a location by name
+  void ShaderProgram::reflectUniforms() {
+    uniforms_.clear();
+    GLint uniform_count = 0, max_name_length = 0;
+    glGetProgramiv(this->shader_program_handle_, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(this->shader_program_handle_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+    std::string name(max_name_length, '\0');
+    for (GLint i = 0; i < uniform_count; i++) {
+      GLsizei name_length = 0;
+      GLint size = 0;
+      GLenum type = 0;
+      glGetActiveUniform(this->shader_program_handle_, i, max_name_length, &name_length, &size, &type, name.data());
+      Uniform uniform;
+      uniform.name = name.substr(0, name_length);
+      uniform.location = glGetUniformLocation(this->shader_program_handle_, uniform.name.c_str());
+      if (uniform.location < 0) {
+        continue; // Uniform block members have no location
+      }
+      // Arrays are reported as name[0], they are looked up by their plain name
+      if (uniform.name.ends_with("[0]")) {
+        uniform.name.resize(uniform.name.size() - 3);
+      }
+      uniform.id = UniformId(uniform.name);
+      uniform.type = type;
+      uniform.size = size;
+      uniforms_.push_back(std::move(uniform));
+    }
+    std::sort(uniforms_.begin(), uniforms_.end(), [](const Uniform& a, const Uniform& b) {
+      return a.id < b.id;
+    });
+    auto collision = std::adjacent_find(uniforms_.begin(), uniforms_.end(), [](const Uniform& a, const Uniform& b) {
+      return a.id == b.id;
+    });
+    if (collision != uniforms_.end()) {
+      throw std::runtime_error("Uniforms " + collision->name + " and " + std::next(collision)->name + " have the same id");
+    }
+  }
+  int ShaderProgram::getUniformLocation(UniformId id) const noexcept {
+    auto uniform = std::lower_bound(uniforms_.begin(), uniforms_.end(), id, [](const Uniform& a, UniformId b) {
+      return a.id < b;
+    });
+    if (uniform == uniforms_.end() || uniform->id != id) {
+      return -1;
+    }
+    return uniform->location;
   }
   ShaderProgram::~ShaderProgram() {
     glDeleteProgram(this->shader_program_handle_);
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->onProgramDeleted(this->shader_program_handle_);
+    }
   }
   inline bool EnsureShaderProgramIsActive(ShaderProgram& program) {
     if (!program.isActive()) {
@@ -66,38 +162,45 @@ namespace citrus::opengl {
     }
     return true;
   }
-  void ShaderProgram::setUniformVal(std::string_view uniform_name, Vector2f value) {
+  void ShaderProgram::setUniformVal(int location, Vector2f value) {
     EnsureShaderProgramIsActive(*this);
-    glUniform2f(glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), value.x, value.y);
+    glUniform2f(location, value.x, value.y);
   }
-  void ShaderProgram::setUniformVal(std::string_view uniform_name, Vector3f value) {
+  void ShaderProgram::setUniformVal(int location, Vector3f value) {
     EnsureShaderProgramIsActive(*this);
-    glUniform3f(glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), value.x, value.y, value.z);
+    glUniform3f(location, value.x, value.y, value.z);
   }
-  void ShaderProgram::setUniformVal(std::string_view uniform_name, Color value) {
+  void ShaderProgram::setUniformVal(int location, Color value) {
     EnsureShaderProgramIsActive(*this);
     auto color_arr = value.asFloatRgba();
-    glUniform4f(glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), color_arr[0], color_arr[1], color_arr[2], color_arr[3]);
+    glUniform4f(location, color_arr[0], color_arr[1], color_arr[2], color_arr[3]);
   }
-  void ShaderProgram::setUniformVal(std::string_view uniform_name, float value) {
+  void ShaderProgram::setUniformVal(int location, float value) {
     EnsureShaderProgramIsActive(*this);
-    glUniform1f(glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), value);
+    glUniform1f(location, value);
   }
-  void ShaderProgram::setUniformVal(std::string_view uniform_name, int value) {
+  void ShaderProgram::setUniformVal(int location, int value) {
     EnsureShaderProgramIsActive(*this);
-    glUniform1i(glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), value);
+    glUniform1i(location, value);
+  }
+  void ShaderProgram::bindUniformBlock(std::string_view block_name, unsigned int binding_point) {
+    const GLuint block_index = glGetUniformBlockIndex(this->shader_program_handle_, std::string(block_name).c_str());
+    if (block_index == GL_INVALID_INDEX) {
+      throw std::runtime_error("Shader program has no uniform block named " + std::string(block_name));
+    }
+    glUniformBlockBinding(this->shader_program_handle_, block_index, binding_point);
   }
   void ShaderProgram::getUniformVal(std::string_view uniform_name, Vector2f& value) {
     EnsureShaderProgramIsActive(*this);
     GLfloat params[2];
-    glGetUniformfv(this->shader_program_handle_, glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), params);
+    glGetUniformfv(this->shader_program_handle_, this->getUniformLocation(uniform_name), params);
     value.x = params[0];
     value.y = params[1];
   }
   void ShaderProgram::getUniformVal(std::string_view uniform_name, Vector3f& value) {
     EnsureShaderProgramIsActive(*this);
     GLfloat params[3];
-    glGetUniformfv(this->shader_program_handle_, glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), params);
+    glGetUniformfv(this->shader_program_handle_, this->getUniformLocation(uniform_name), params);
     value.x = params[0];
     value.y = params[1];
     value.z = params[2];
@@ -105,16 +208,16 @@ namespace citrus::opengl {
   void ShaderProgram::getUniformVal(std::string_view uniform_name, Color& value) {
     EnsureShaderProgramIsActive(*this);
     GLfloat params[4];
-    glGetUniformfv(this->shader_program_handle_, glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), params);
+    glGetUniformfv(this->shader_program_handle_, this->getUniformLocation(uniform_name), params);
     value = Color(params[0], params[1], params[2], params[3]);
   }
   void ShaderProgram::getUniformVal(std::string_view uniform_name, float& value) {
     EnsureShaderProgramIsActive(*this);
-    glGetUniformfv(this->shader_program_handle_, glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), &value);
+    glGetUniformfv(this->shader_program_handle_, this->getUniformLocation(uniform_name), &value);
   }
   void ShaderProgram::getUniformVal(std::string_view uniform_name, int& value) {
     EnsureShaderProgramIsActive(*this);
-    glGetUniformiv(this->shader_program_handle_, glGetUniformLocation(this->shader_program_handle_, uniform_name.data()), &value);
+    glGetUniformiv(this->shader_program_handle_, this->getUniformLocation(uniform_name), &value);
   }
 
 }
\ No newline at end of file
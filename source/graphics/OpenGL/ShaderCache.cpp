@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+#include "Citrus/graphics/OpenGL/ShaderCache.hpp"
+#include "glad/glad.h"
+
+namespace citrus::opengl {
+
+  static constexpr char CACHE_MAGIC[8] = {'C', 'T', 'R', 'S', 'P', 'R', 'G', '1'};
+
+  // 64 bit FNV-1a, every part is followed by a separator so ("ab", "c") and ("a", "bc") differ
+  static void HashAppend(uint64_t& hash, std::string_view part) {
+    for (char c : part) {
+      hash ^= static_cast<uint8_t>(c);
+      hash *= 1099511628211ull;
+    }
+    hash ^= 0xFF;
+    hash *= 1099511628211ull;
+  }
+
+  static std::string GlString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+  }
+
+  static std::string ApplyDefines(std::string_view source, std::span<const std::string_view> defines) {
+    std::string define_lines;
+    for (std::string_view define : defines) {
+      define_lines += "#define ";
+      define_lines += define;
+      define_lines += '\n';
+    }
+    // #version has to stay the first statement
+    size_t insert_at = 0;
+    if (source.starts_with("#version")) {
+      const size_t line_end = source.find('\n');
+      insert_at = line_end == std::string_view::npos ? source.size() : line_end + 1;
+    }
+    std::string result(source.substr(0, insert_at));
+    if (insert_at == source.size() && !result.empty() && result.back() != '\n') {
+      result += '\n';
+    }
+    result += define_lines;
+    result += source.substr(insert_at);
+    return result;
+  }
+
+  ShaderCache::ShaderCache(std::filesystem::path directory) : directory_(std::move(directory)) {
+    driver_ = GlString(GL_VENDOR) + '\n' + GlString(GL_RENDERER) + '\n' + GlString(GL_VERSION);
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+  }
+
+  ShaderProgram ShaderCache::load(std::string_view vertex_source, std::string_view fragment_source, std::span<const std::string_view> defines) {
+    uint64_t hash = 14695981039346656037ull;
+    HashAppend(hash, driver_);
+    HashAppend(hash, vertex_source);
+    HashAppend(hash, fragment_source);
+    for (std::string_view define : defines) {
+      HashAppend(hash, define);
+    }
+    char file_name[32];
+    std::snprintf(file_name, sizeof(file_name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    const std::filesystem::path path = directory_ / file_name;
+
+    // Entry layout: magic, binary format, binary
+    if (std::ifstream file{path, std::ios::binary}) {
+      std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      if (contents.size() > sizeof(CACHE_MAGIC) + sizeof(uint32_t) && std::memcmp(contents.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0) {
+        uint32_t format;
+        std::memcpy(&format, contents.data() + sizeof(CACHE_MAGIC), sizeof(format));
+        const size_t header_size = sizeof(CACHE_MAGIC) + sizeof(format);
+        auto binary = std::as_bytes(std::span<const char>(contents).subspan(header_size));
+        if (auto program = ShaderProgram::FromBinary(format, binary)) {
+          hits_++;
+          return std::move(*program);
+        }
+      }
+    }
+
+    misses_++;
+    auto vertex_shader = Shader(std::string_view(ApplyDefines(vertex_source, defines)), Shader::ShaderType::VERTEX);
+    auto fragment_shader = Shader(std::string_view(ApplyDefines(fragment_source, defines)), Shader::ShaderType::FRAGMENT);
+    ShaderProgram program(vertex_shader, fragment_shader, true);
+
+    unsigned int format = 0;
+    const std::vector<std::byte> binary = program.getBinary(format);
+    if (!binary.empty()) {
+      // Written next to the entry and renamed so a crash never leaves half an entry behind
+      std::filesystem::path temporary_path = path;
+      temporary_path += ".tmp";
+      std::ofstream file(temporary_path, std::ios::binary);
+      const uint32_t stored_format = format;
+      file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+      file.write(reinterpret_cast<const char*>(&stored_format), sizeof(stored_format));
+      file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+      file.close();
+      std::error_code error;
+      if (file) {
+        std::filesystem::rename(temporary_path, path, error);
+      } else {
+        std::filesystem::remove(temporary_path, error);
+      }
+    }
+    return program;
+  }
+
+}
@@ -0,0 +1,155 @@
+#include <stdexcept>
+
+#include "Citrus/graphics/OpenGL/ShaderCompiler.hpp"
+#include "Citrus/sys/Profiler.hpp"
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+namespace citrus::opengl {
+
+  // From GL_KHR_parallel_shader_compile, the generated loader doesn't include extensions
+  static constexpr GLenum GL_COMPLETION_STATUS_KHR = 0x91B1;
+  using MaxShaderCompilerThreadsFunc = void (*)(GLuint count);
+
+  static unsigned int StartCompile(std::string_view source, Shader::ShaderType type) {
+    const unsigned int shader = glCreateShader(CitrusGlToGlShaderType(type));
+    const char* src = source.data();
+    const GLint src_length = source.size();
+    glShaderSource(shader, 1, &src, &src_length);
+    glCompileShader(shader);
+    return shader;
+  }
+
+  static std::string ShaderLog(unsigned int shader, const char* stage) {
+    GLint success = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success) {
+      return "";
+    }
+    GLint info_log_size = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_size);
+    std::string info_log(info_log_size, '\0');
+    glGetShaderInfoLog(shader, info_log_size, nullptr, info_log.data());
+    return std::string(stage) + " shader: " + info_log.c_str() + "\n";
+  }
+
+  ShaderCompiler::ShaderCompiler() {
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+      auto max_threads = reinterpret_cast<MaxShaderCompilerThreadsFunc>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+      if (max_threads) {
+        max_threads(0xFFFFFFFF); // Let the driver pick
+        parallel_compile_ = true;
+      }
+    }
+  }
+
+  ShaderCompiler::~ShaderCompiler() {
+    for (Job& job : jobs_) {
+      glDeleteShader(job.vertex_shader);
+      glDeleteShader(job.fragment_shader);
+      if (!job.taken) {
+        glDeleteProgram(job.program);
+      }
+    }
+  }
+
+  ShaderCompiler::Handle ShaderCompiler::submit(std::string_view vertex_source, std::string_view fragment_source) {
+    CITRUS_PROFILE_SCOPE("ShaderCompiler::submit");
+    Job job;
+    job.vertex_shader = StartCompile(vertex_source, Shader::ShaderType::VERTEX);
+    job.fragment_shader = StartCompile(fragment_source, Shader::ShaderType::FRAGMENT);
+    // Linking straight away is fine, a failed compile just makes the link fail and both logs are read then
+    job.program = glCreateProgram();
+    glAttachShader(job.program, job.vertex_shader);
+    glAttachShader(job.program, job.fragment_shader);
+    glLinkProgram(job.program);
+    jobs_.push_back(std::move(job));
+    pending_.push_back(jobs_.size() - 1);
+    return Handle{static_cast<uint32_t>(jobs_.size() - 1)};
+  }
+
+  size_t ShaderCompiler::poll(std::chrono::microseconds budget) {
+    CITRUS_PROFILE_SCOPE("ShaderCompiler::poll");
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    size_t kept = 0, finished = 0;
+    for (size_t i = 0; i < pending_.size(); i++) {
+      Job& job = jobs_[pending_[i]];
+      bool done;
+      if (parallel_compile_) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+        done = completed;
+      } else {
+        // Without the extension reading the status blocks until the program is linked, spread that over frames
+        // while still finishing at least one program per poll
+        done = finished == 0 || std::chrono::steady_clock::now() < deadline;
+      }
+      if (done) {
+        this->finish(job);
+        finished++;
+      } else {
+        pending_[kept++] = pending_[i];
+      }
+    }
+    pending_.resize(kept);
+    return pending_.size();
+  }
+
+  void ShaderCompiler::finish(Job& job) {
+    GLint success = GL_FALSE;
+    glGetProgramiv(job.program, GL_LINK_STATUS, &success);
+    if (success) {
+      job.status = Status::READY;
+    } else {
+      GLint info_log_size = 0;
+      glGetProgramiv(job.program, GL_INFO_LOG_LENGTH, &info_log_size);
+      std::string info_log(info_log_size, '\0');
+      glGetProgramInfoLog(job.program, info_log_size, nullptr, info_log.data());
+      job.error = ShaderLog(job.vertex_shader, "Vertex") + ShaderLog(job.fragment_shader, "Fragment") + "Link: " + info_log.c_str();
+      job.status = Status::FAILED;
+    }
+    // The program keeps its code, the shader objects aren't needed anymore
+    glDetachShader(job.program, job.vertex_shader);
+    glDetachShader(job.program, job.fragment_shader);
+    glDeleteShader(job.vertex_shader);
+    glDeleteShader(job.fragment_shader);
+    job.vertex_shader = job.fragment_shader = 0;
+  }
+
+  ShaderCompiler::Job& ShaderCompiler::getJob(Handle handle) {
+    if (handle.index >= jobs_.size()) {
+      throw std::runtime_error("Invalid shader compiler handle");
+    }
+    return jobs_[handle.index];
+  }
+  const ShaderCompiler::Job& ShaderCompiler::getJob(Handle handle) const {
+    if (handle.index >= jobs_.size()) {
+      throw std::runtime_error("Invalid shader compiler handle");
+    }
+    return jobs_[handle.index];
+  }
+
+  ShaderCompiler::Status ShaderCompiler::getStatus(Handle handle) const {
+    return this->getJob(handle).status;
+  }
+
+  const std::string& ShaderCompiler::getError(Handle handle) const {
+    return this->getJob(handle).error;
+  }
+
+  ShaderProgram ShaderCompiler::take(Handle handle) {
+    Job& job = this->getJob(handle);
+    if (job.status == Status::PENDING) {
+      throw std::runtime_error("Attempted to take a shader program that is still compiling");
+    }
+    if (job.status == Status::FAILED) {
+      throw std::runtime_error(job.error);
+    }
+    if (job.taken) {
+      throw std::runtime_error("Shader program was already taken");
+    }
+    job.taken = true;
+    return ShaderProgram::FromLinkedProgram(job.program);
+  }
+
+}
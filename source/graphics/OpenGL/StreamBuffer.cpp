@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+
+#include "glad/glad.h"
+#include "Citrus/graphics/OpenGL/GlStateCache.hpp"
+#include "Citrus/graphics/OpenGL/StreamBuffer.hpp"
+
+namespace citrus::opengl {
+
+  static constexpr GLbitfield PERSISTENT_MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  static void WaitAndDeleteFence(void*& fence) {
+    if (!fence) {
+      return;
+    }
+    GLsync sync = static_cast<GLsync>(fence);
+    while (true) {
+      GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+      if (result != GL_TIMEOUT_EXPIRED) {
+        break;
+      }
+    }
+    glDeleteSync(sync);
+    fence = nullptr;
+  }
+
+  static size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // Stream buffers are only written through the copy write target, so the binding is left in place
+  static void BindCopyWriteBuffer(unsigned int buffer) {
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->bindBuffer(GlStateCache::BufferTarget::COPY_WRITE, buffer);
+    } else {
+      glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    }
+  }
+
+  // Unique across every stream buffer, a moved-in stream never reuses the generation of the one it replaces
+  static uint64_t NextGeneration() {
+    static std::atomic<uint64_t> generation = 0;
+    return ++generation;
+  }
+
+  StreamBuffer::StreamBuffer(size_t region_size) {
+    persistent_ = GLAD_GL_VERSION_4_4;
+    createStorage(region_size);
+  }
+
+  StreamBuffer::StreamBuffer(StreamBuffer&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  StreamBuffer& StreamBuffer::operator=(StreamBuffer&& other) noexcept {
+    if (this == &other) {
+      return *this;
+    }
+    if (buffer_handle_) {
+      destroyStorage();
+    }
+    buffer_handle_ = std::exchange(other.buffer_handle_, 0);
+    generation_ = std::exchange(other.generation_, 0);
+    persistent_ = other.persistent_;
+    frame_started_ = std::exchange(other.frame_started_, false);
+    mapped_ = std::exchange(other.mapped_, nullptr);
+    region_size_ = std::exchange(other.region_size_, 0);
+    region_index_ = std::exchange(other.region_index_, 0);
+    head_ = std::exchange(other.head_, 0);
+    flushed_ = std::exchange(other.flushed_, 0);
+    fences_ = std::exchange(other.fences_, {});
+    staging_ = std::move(other.staging_);
+    return *this;
+  }
+
+  StreamBuffer::~StreamBuffer() {
+    if (buffer_handle_) {
+      destroyStorage();
+    }
+  }
+
+  void StreamBuffer::createStorage(size_t region_size) {
+    region_size_ = region_size;
+    generation_ = NextGeneration();
+    glGenBuffers(1, &buffer_handle_);
+    BindCopyWriteBuffer(buffer_handle_);
+    if (persistent_) {
+      const size_t total_size = region_size_ * FRAMES_IN_FLIGHT;
+      glBufferStorage(GL_COPY_WRITE_BUFFER, total_size, nullptr, PERSISTENT_MAP_FLAGS);
+      mapped_ = static_cast<std::byte*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total_size, PERSISTENT_MAP_FLAGS));
+      if (!mapped_) {
+        throw std::runtime_error("Failed to persistently map the stream buffer");
+      }
+    } else {
+      glBufferData(GL_COPY_WRITE_BUFFER, region_size_, nullptr, GL_STREAM_DRAW);
+      staging_.resize(region_size_);
+    }
+  }
+
+  void StreamBuffer::destroyStorage() {
+    for (void*& fence : fences_) {
+      WaitAndDeleteFence(fence);
+    }
+    if (mapped_) {
+      BindCopyWriteBuffer(buffer_handle_);
+      glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+      mapped_ = nullptr;
+    }
+    glDeleteBuffers(1, &buffer_handle_);
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->onBufferDeleted(buffer_handle_);
+    }
+    buffer_handle_ = 0;
+  }
+
+  void StreamBuffer::beginFrame() {
+    if (persistent_) {
+      // Wait until the GPU is done reading what we wrote to this region FRAMES_IN_FLIGHT frames ago
+      WaitAndDeleteFence(fences_[region_index_]);
+      head_ = region_index_ * region_size_;
+    } else {
+      // Orphan the buffer, the driver hands us fresh storage instead of syncing with pending draws
+      BindCopyWriteBuffer(buffer_handle_);
+      glBufferData(GL_COPY_WRITE_BUFFER, region_size_, nullptr, GL_STREAM_DRAW);
+      head_ = 0;
+    }
+    flushed_ = head_;
+    frame_started_ = true;
+  }
+
+  StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    if (!frame_started_) {
+      beginFrame();
+    }
+    const size_t region_begin = persistent_ ? region_index_ * region_size_ : 0;
+    size_t offset = AlignUp(head_, alignment);
+    if (offset + size > region_begin + region_size_) {
+      // Grow the buffer, draws already issued keep the old storage alive until they are done
+      const size_t new_region_size = std::max(region_size_ * 2, AlignUp(size + alignment, 256));
+      if (persistent_) {
+        if (head_ != region_begin) {
+          throw std::runtime_error("A persistent stream buffer can only grow on the first allocation of a frame");
+        }
+        destroyStorage();
+        createStorage(new_region_size);
+        region_index_ = 0;
+        head_ = flushed_ = 0;
+      } else {
+        region_size_ = new_region_size;
+        staging_.resize(region_size_);
+        BindCopyWriteBuffer(buffer_handle_);
+        glBufferData(GL_COPY_WRITE_BUFFER, region_size_, nullptr, GL_STREAM_DRAW);
+        flushed_ = 0; // The new storage is empty, re-upload everything staged this frame
+      }
+      offset = AlignUp(head_, alignment);
+    }
+    head_ = offset + size;
+    std::byte* base = persistent_ ? mapped_ : staging_.data();
+    return Allocation{base + offset, offset};
+  }
+
+  void StreamBuffer::flush() {
+    if (!persistent_ && head_ > flushed_) {
+      BindCopyWriteBuffer(buffer_handle_);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, flushed_, head_ - flushed_, staging_.data() + flushed_);
+    }
+    // Persistent storage is coherent, writes become visible to commands issued after this point
+    flushed_ = head_;
+  }
+
+  void StreamBuffer::endFrame() {
+    if (!frame_started_) {
+      return;
+    }
+    if (persistent_) {
+      fences_[region_index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      region_index_ = (region_index_ + 1) % FRAMES_IN_FLIGHT;
+    }
+    frame_started_ = false;
+  }
+
+  void StreamBuffer::fenceLastFrameAgain() {
+    if (!persistent_ || frame_started_) {
+      return;
+    }
+    void*& fence = fences_[(region_index_ + FRAMES_IN_FLIGHT - 1) % FRAMES_IN_FLIGHT];
+    if (fence) {
+      glDeleteSync(static_cast<GLsync>(fence));
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+}
@@ -0,0 +1,73 @@
+#include <stdexcept>
+#include <utility>
+
+#include "Citrus/graphics/OpenGL/GlStateCache.hpp"
+#include "Citrus/graphics/OpenGL/UniformBlock.hpp"
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+namespace citrus::opengl {
+
+  static void BindUniformBuffer(unsigned int buffer) {
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->bindBuffer(GlStateCache::BufferTarget::UNIFORM, buffer);
+    } else {
+      glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    }
+  }
+
+  static void CheckContext() {
+    if (!glfwGetCurrentContext()) {
+      throw std::runtime_error("Attempted to use a uniform buffer from a thread without a GL context, go through the renderer instead");
+    }
+  }
+
+  UniformBuffer::UniformBuffer(size_t size, const void* data) {
+    glGenBuffers(1, &buffer_handle_);
+    BindUniformBuffer(buffer_handle_);
+    glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+  }
+
+  UniformBuffer::UniformBuffer(UniformBuffer&& other) noexcept {
+    buffer_handle_ = std::exchange(other.buffer_handle_, 0);
+  }
+
+  UniformBuffer& UniformBuffer::operator=(UniformBuffer&& other) noexcept {
+    if (this != &other) {
+      this->release();
+      buffer_handle_ = std::exchange(other.buffer_handle_, 0);
+    }
+    return *this;
+  }
+
+  UniformBuffer::~UniformBuffer() {
+    this->release();
+  }
+
+  void UniformBuffer::release() {
+    if (!buffer_handle_) {
+      return;
+    }
+    glDeleteBuffers(1, &buffer_handle_);
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->onBufferDeleted(buffer_handle_);
+    }
+    buffer_handle_ = 0;
+  }
+
+  void UniformBuffer::upload(size_t offset, size_t size, const void* data) {
+    CheckContext();
+    BindUniformBuffer(buffer_handle_);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+  }
+
+  void UniformBuffer::bind(unsigned int binding_point) const {
+    CheckContext();
+    if (GlStateCache* cache = GlStateCache::Current()) {
+      cache->bindBufferBase(GlStateCache::BufferTarget::UNIFORM, binding_point, buffer_handle_);
+    } else {
+      glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, buffer_handle_);
+    }
+  }
+
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "Citrus/graphics/core/FrameArena.hpp"
+
+namespace citrus {
+
+  FrameArena::FrameArena(size_t initial_capacity) {
+    this->addBlock(std::max<size_t>(initial_capacity, 1));
+    upstream_allocations_ = 0;
+  }
+
+  void FrameArena::addBlock(size_t size) {
+    blocks_.push_back(Block{std::make_unique<std::byte[]>(size), size});
+    block_offset_ = 0;
+    upstream_allocations_++;
+  }
+
+  void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+    Block& block = blocks_.back();
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block.data.get()) + block_offset_;
+    size_t padding = (alignment - address % alignment) % alignment;
+    if (block_offset_ + padding + bytes > block.size) {
+      this->addBlock(std::max(block.size * 2, bytes + alignment));
+      address = reinterpret_cast<std::uintptr_t>(blocks_.back().data.get());
+      padding = (alignment - address % alignment) % alignment;
+    }
+    void* result = blocks_.back().data.get() + block_offset_ + padding;
+    block_offset_ += padding + bytes;
+    bytes_used_ += padding + bytes;
+    return result;
+  }
+
+  void FrameArena::reset() {
+    // A frame that fits in what a previous frame used must not have touched the heap
+    assert(upstream_allocations_ == 0 || bytes_used_ > peak_bytes_used_);
+    peak_bytes_used_ = std::max(peak_bytes_used_, bytes_used_);
+    if (blocks_.size() > 1) {
+      // The frame outgrew the arena, keep a single block big enough for it
+      const size_t capacity = this->getCapacity();
+      blocks_.clear();
+      this->addBlock(capacity);
+    }
+    block_offset_ = 0;
+    bytes_used_ = 0;
+    upstream_allocations_ = 0;
+  }
+
+  size_t FrameArena::getCapacity() const noexcept {
+    size_t capacity = 0;
+    for (const Block& block : blocks_) {
+      capacity += block.size;
+    }
+    return capacity;
+  }
+
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Citrus/sys/Profiler.hpp"
+
+namespace citrus {
+  namespace {
+    struct ZoneEvent {
+      const char* name;
+      uint64_t start_ns;
+      uint64_t end_ns;
+    };
+
+    // Written by its own thread only, count is published with release so a reader never sees a partial event
+    struct ThreadBuffer {
+      std::unique_ptr<ZoneEvent[]> events = std::make_unique<ZoneEvent[]>(Profiler::EVENTS_PER_THREAD);
+      std::atomic<size_t> count = 0;
+      std::atomic<uint32_t> capture = 0; // Capture the events belong to
+      size_t thread_index = 0;
+    };
+
+    std::atomic<bool> s_capturing = false;
+    std::atomic<uint32_t> s_capture = 0;
+    std::atomic<uint64_t> s_capture_start_ns = 0;
+    std::atomic<uint64_t> s_dropped_events = 0;
+    // Buffers outlive their threads so a capture can still be written after a thread exits
+    std::mutex s_buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+    ThreadBuffer& LocalBuffer() {
+      thread_local ThreadBuffer* buffer = nullptr;
+      if (!buffer) {
+        std::lock_guard lock(s_buffers_mutex);
+        s_buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = s_buffers.back().get();
+        buffer->thread_index = s_buffers.size() - 1;
+      }
+      return *buffer;
+    }
+
+    void WriteEscaped(std::ofstream& stream, const char* text) {
+      for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+          stream << '\\';
+        }
+        stream << *text;
+      }
+    }
+  }
+
+  uint64_t Profiler::now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void Profiler::beginCapture() {
+    s_dropped_events = 0;
+    s_capture_start_ns = now();
+    s_capture++;
+    s_capturing = true;
+  }
+  void Profiler::endCapture() {
+    s_capturing = false;
+  }
+  bool Profiler::isCapturing() noexcept {
+    return s_capturing.load(std::memory_order_relaxed);
+  }
+  uint64_t Profiler::getDroppedEventCount() noexcept {
+    return s_dropped_events;
+  }
+
+  void Profiler::recordZone(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    if (!isCapturing()) {
+      return;
+    }
+    ThreadBuffer& buffer = LocalBuffer();
+    const uint32_t capture = s_capture.load(std::memory_order_acquire);
+    if (buffer.capture.load(std::memory_order_relaxed) != capture) {
+      // First zone of this thread in a new capture, the previous capture's events are dropped
+      buffer.count.store(0, std::memory_order_relaxed);
+      buffer.capture.store(capture, std::memory_order_release);
+    }
+    const size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index == EVENTS_PER_THREAD) {
+      s_dropped_events.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    buffer.events[index] = ZoneEvent{name, start_ns, end_ns};
+    buffer.count.store(index + 1, std::memory_order_release);
+  }
+
+  void Profiler::writeChromeTrace(const std::filesystem::path& path) {
+    std::ofstream stream(path);
+    if (!stream) {
+      throw std::runtime_error("Failed to open " + path.string() + " for writing the trace");
+    }
+    const uint32_t capture = s_capture.load(std::memory_order_acquire);
+    const uint64_t capture_start_ns = s_capture_start_ns;
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard lock(s_buffers_mutex);
+    for (const auto& buffer : s_buffers) {
+      if (buffer->capture.load(std::memory_order_acquire) != capture) {
+        continue;
+      }
+      const size_t count = buffer->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; i++) {
+        const ZoneEvent& event = buffer->events[i];
+        // Complete events, timestamps in microseconds from the start of the capture
+        stream << (first ? "" : ",") << "\n{\"name\":\"";
+        WriteEscaped(stream, event.name);
+        stream << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_index
+               << ",\"ts\":" << (event.start_ns - std::min(event.start_ns, capture_start_ns)) / 1000.0
+               << ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0 << "}";
+        first = false;
+      }
+    }
+    stream << "\n]}\n";
+  }
+}
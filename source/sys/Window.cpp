@@ -1,6 +1,9 @@
+#include <chrono>
+#include <cstdint>
 #include <stdexcept>
 #include "GLFW/glfw3.h"
 #include "Citrus/sys/Window.hpp"
+#include "Citrus/sys/Profiler.hpp"
 
 namespace citrus {
   Window::Window(std::string_view name, Vector2u size, bool isResizable, bool isDecorated, bool createOpenGlContext, bool isFullsceen, Monitor* monitor) {
@@ -61,6 +64,19 @@ namespace citrus {
       Window* win = static_cast<Window*>(glfwGetWindowUserPointer(window));
       win->addEventToQueue(Event(Event::Closed()));
     });
+    glfwSetWindowSizeCallback(glfw_window_, [](GLFWwindow* window, int width, int height) {
+      Window* win = static_cast<Window*>(glfwGetWindowUserPointer(window));
+      if (win) {
+        win->addEventToQueue(Event(Event::Resized{Vector2i{width, height}}));
+      }
+    });
+    // Uncovered or damaged windows need their contents drawn again even if nothing changed
+    glfwSetWindowRefreshCallback(glfw_window_, [](GLFWwindow* window) {
+      Window* win = static_cast<Window*>(glfwGetWindowUserPointer(window));
+      if (win) {
+        win->redraw_requested_ = true;
+      }
+    });
   }
   void Window::addEventToQueue(Event&& evt) {
     evt_queue_.push(std::forward<Event>(evt));
@@ -75,8 +91,15 @@ namespace citrus {
   }
 
   std::optional<Window::Event> Window::getEvent() {
-    glfwPollEvents();
+    CITRUS_PROFILE_SCOPE("Window::getEvent");
+    if (event_mode_ == EventMode::WAIT && !frame_started_) {
+      this->waitForRedraw();
+      frame_started_ = true;
+    } else {
+      glfwPollEvents();
+    }
     if (this->evt_queue_.empty()) {
+      frame_started_ = false;
       return std::nullopt;
     }
     Window::Event evt = this->evt_queue_.front();
@@ -84,6 +107,48 @@ namespace citrus {
     return evt;
   }
 
+  static int64_t SteadyNanoseconds(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+  }
+
+  // Events that don't queue anything, like mouse motion, wake the wait up without ending it
+  void Window::waitForRedraw() {
+    CITRUS_PROFILE_SCOPE("Window::waitForRedraw");
+    glfwPollEvents();
+    while (this->evt_queue_.empty() && !redraw_requested_) {
+      const int64_t deadline = redraw_deadline_;
+      const int64_t now = SteadyNanoseconds(std::chrono::steady_clock::now());
+      if (deadline <= now) {
+        break;
+      }
+      if (deadline == NO_REDRAW_DEADLINE) {
+        glfwWaitEvents();
+      } else {
+        glfwWaitEventsTimeout(static_cast<double>(deadline - now) / 1e9);
+      }
+    }
+    // The frame about to be drawn covers every request made until now
+    redraw_requested_ = false;
+    int64_t deadline = redraw_deadline_;
+    const int64_t now = SteadyNanoseconds(std::chrono::steady_clock::now());
+    while (deadline <= now && !redraw_deadline_.compare_exchange_weak(deadline, NO_REDRAW_DEADLINE)) {
+    }
+  }
+
+  void Window::requestRedraw() {
+    redraw_requested_ = true;
+    glfwPostEmptyEvent();
+  }
+
+  void Window::requestRedrawAt(std::chrono::steady_clock::time_point time) {
+    const int64_t deadline = SteadyNanoseconds(time);
+    int64_t current = redraw_deadline_;
+    while (deadline < current && !redraw_deadline_.compare_exchange_weak(current, deadline)) {
+    }
+    // A waiting getEvent has to pick up the earlier timeout
+    glfwPostEmptyEvent();
+  }
+
   void Window::setSize(Vector2i size) const {
     glfwSetWindowSize(glfw_window_, size.x, size.y);
   }